@@ -0,0 +1,294 @@
+#ifndef ALU_H
+#define ALU_H
+
+/*
+* Primitives shared by every handler. They are static inline so the
+* dispatcher in cpu.c, which includes opcodes.c, can inline whole
+* instructions without relying on LTO.
+*/
+
+#include <stdio.h>
+#include <stdint.h>
+#include "machine.h"
+
+/*
+* The cpu the core is built for, picked at compile time with
+* -DCPU_VARIANT=... (see VARIANT in the Makefile). The 2A03 in the NES has
+* the decimal flag but no decimal mode, so it pays nothing for it.
+*/
+#define CPU_2A03 0
+#define CPU_NMOS 1 // the original 6502, decimal mode leaves N, V and Z undefined
+#define CPU_65C02 2 // decimal mode sets N and Z from the result, one cycle more
+
+#ifndef CPU_VARIANT
+#define CPU_VARIANT CPU_2A03
+#endif
+
+#define HAS_DECIMAL (CPU_VARIANT != CPU_2A03)
+
+#define SET_CARRY(x)   x | 0b00100001
+#define CLEAR_CARRY(x) x & 0b11111110
+#define SET_ZERO(x)    x | 0b00100010
+#define CLEAR_ZERO(x)  x & 0b11111101
+#define SET_OVERFLOW(x) x | 0b01100000
+#define CLEAR_OVERFLOW(x) x & 0b10111111
+#define SET_NEG(x) x | 0b10100000
+#define CLEAR_NEG(x) x & 0b01111111
+#define SET_INTERRUPT(x) x | 0b00100100
+#define CLEAR_INTERRUPT(x) x & 0b11111011
+#define SET_DECIMAL(x) x | 0b00101000
+#define CLEAR_DECIMAL(x) x & 0b11110111
+
+// the flags by bit, for building P with masks instead of branches
+#define FLAG_C 0b00000001
+#define FLAG_Z 0b00000010
+#define FLAG_I 0b00000100
+#define FLAG_D 0b00001000
+#define FLAG_B 0b00010000
+#define FLAG_V 0b01000000
+#define FLAG_N 0b10000000
+
+/*
+* N and Z for every possible result. Every instruction that sets them
+* does so from an 8 bit result, so a load and a mask replace the two
+* compares and the branches on them.
+*/
+static const uint8_t nz_table[256] = {
+	[0x00] = FLAG_Z,
+	[0x80 ... 0xFF] = FLAG_N
+};
+
+#if HAS_DECIMAL
+/* Low digit of a decimal add, indexed by (A & 0x0F) + (value & 0x0F) + carry */
+static const uint8_t bcd_add_lo[32] = {
+	0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x10, 0x11, 0x12, 0x13, 0x14, 0x15,
+	0x16, 0x17, 0x18, 0x19, 0x1A, 0x1B, 0x1C, 0x1D, 0x1E, 0x1F, 0x10, 0x11, 0x12, 0x13, 0x14, 0x15
+};
+
+/* Low digit of a decimal subtract, indexed by (A & 0x0F) - (value & 0x0F) + carry - 1 + 16 */
+static const int8_t bcd_sub_lo[32] = {
+	-6, -5, -4, -3, -2, -1, -16, -15, -14, -13, -12, -11, -10, -9, -8, -7,
+	0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15
+};
+#endif
+
+/* set N and Z from a result */
+static ALWAYS_INLINE uint8_t nz_flags(uint8_t P, uint8_t result)
+{
+	return (P & ~(FLAG_N | FLAG_Z)) | nz_table[result];
+}
+
+/*
+* Set C and V from the 9 bit sum a + b + carry: C is bit 8, V is set when
+* a and b have the same sign and the sum does not. Subtracting is adding
+* ~value, so SBC and the compares come through here too.
+*/
+static ALWAYS_INLINE uint8_t cv_flags(uint8_t P, uint8_t a, uint8_t b, unsigned sum)
+{
+	P &= ~(FLAG_C | FLAG_V);
+	return P | ((sum >> 8) & FLAG_C) | (((a ^ sum) & (b ^ sum) & 0x80) >> 1);
+}
+
+/*
+* ADC - the instruction proper: add value and the carry to A.
+* Flags affected: N, V, Z, C
+* In decimal mode the digits are adjusted from bcd_add_lo; N and V come
+* from the sum before the high digit is adjusted, as on the NMOS part.
+*/
+static ALWAYS_INLINE void adc_a(cpu_core* cpu, uint8_t value)
+{
+	uint8_t A = cpu->A;
+	uint8_t carry = cpu->P & FLAG_C;
+	unsigned sum = A + value + carry;
+	uint8_t P = cv_flags(nz_flags(cpu->P, sum), A, value, sum);
+
+#if HAS_DECIMAL
+	if (cpu->P & FLAG_D) {
+		sum = (A & 0xF0) + (value & 0xF0) + bcd_add_lo[(A & 0x0F) + (value & 0x0F) + carry];
+		P = (P & ~FLAG_N) | (sum & FLAG_N);
+		P = cv_flags(P, A, value, sum) & ~FLAG_C;
+		if (sum >= 0xA0) {
+			sum += 0x60;
+		}
+		P |= sum > 0xFF;
+#if CPU_VARIANT == CPU_65C02
+		P = nz_flags(P, sum);
+		cpu->cycle += 1;
+#endif
+	}
+#endif
+
+	cpu->P = P;
+	cpu->A = sum;
+}
+
+/*
+* SBC - subtract value and the borrow (carry clear) from A.
+* Flags affected: N, V, Z, C
+* Decimal mode only changes the result on the NMOS part, the flags are
+* those of the binary subtract.
+*/
+static ALWAYS_INLINE void sbc_a(cpu_core* cpu, uint8_t value)
+{
+	uint8_t A = cpu->A;
+	uint8_t carry = cpu->P & FLAG_C;
+	unsigned diff = A + (uint8_t) ~value + carry;
+	uint8_t P = cv_flags(nz_flags(cpu->P, diff), A, ~value, diff);
+
+#if HAS_DECIMAL
+	if (cpu->P & FLAG_D) {
+		int lo = (A & 0x0F) - (value & 0x0F) + carry - 1;
+#if CPU_VARIANT == CPU_65C02
+		int result = A - value + carry - 1;
+		if (result < 0) {
+			result -= 0x60;
+		}
+		if (lo < 0) {
+			result -= 0x06;
+		}
+		P = nz_flags(P, result);
+		cpu->cycle += 1;
+#else
+		int result = (A & 0xF0) - (value & 0xF0) + bcd_sub_lo[lo + 16];
+		if (result < 0) {
+			result -= 0x60;
+		}
+#endif
+		diff = result;
+	}
+#endif
+
+	cpu->P = P;
+	cpu->A = diff;
+}
+
+/*
+* CMP, CPX, CPY - reg - value without storing it.
+* Flags affected: N, Z, C (set when reg >= value)
+*/
+static ALWAYS_INLINE uint8_t compare(uint8_t P, uint8_t reg, uint8_t value)
+{
+	unsigned diff = reg + (uint8_t) ~value + 1;
+
+	return (nz_flags(P, diff) & ~FLAG_C) | (diff >> 8);
+}
+
+/* base + index, a cycle more when that crosses into the next page */
+static ALWAYS_INLINE uint16_t indexed(cpu_core* cpu, uint16_t base, uint8_t index)
+{
+	uint16_t address = base + index;
+
+	cpu->cycle += (address ^ base) > 0xFF;
+	return address;
+}
+
+/* (zp,X) - the zero page pointer at address + X, wrapping in the zero page */
+static ALWAYS_INLINE uint16_t indx_address(uint8_t address, cpu_core* cpu, machine* mch)
+{
+	uint8_t pointer = address + cpu->X;
+
+	return cpu_read(cpu, mch, pointer) | ((uint16_t) cpu_read(cpu, mch, (uint8_t) (pointer + 1)) << 8);
+}
+
+/* (zp),Y - the zero page pointer at address, offset by Y */
+static ALWAYS_INLINE uint16_t indy_address(uint8_t address, cpu_core* cpu, machine* mch)
+{
+	uint16_t base = cpu_read(cpu, mch, address) | ((uint16_t) cpu_read(cpu, mch, (uint8_t) (address + 1)) << 8);
+
+	return indexed(cpu, base, cpu->Y);
+}
+
+/*
+* AND, ORA, EOR - bitwise with the accumulator
+* Flags affected: N, Z
+*/
+static ALWAYS_INLINE void and(cpu_core* cpu, uint8_t value)
+{
+	cpu->A &= value;
+	cpu->P = nz_flags(cpu->P, cpu->A);
+}
+
+static ALWAYS_INLINE void or(cpu_core* cpu, uint8_t value)
+{
+	cpu->A |= value;
+	cpu->P = nz_flags(cpu->P, cpu->A);
+}
+
+static ALWAYS_INLINE void eor(cpu_core* cpu, uint8_t value)
+{
+	cpu->A ^= value;
+	cpu->P = nz_flags(cpu->P, cpu->A);
+}
+
+/*
+* ASL - shift left, bit 7 goes into the carry
+* Flags affected: N, Z, C
+*/
+static ALWAYS_INLINE uint8_t asl(cpu_core* cpu, uint8_t value)
+{
+	uint8_t result = value << 1;
+
+	cpu->P = (nz_flags(cpu->P, result) & ~FLAG_C) | (value >> 7);
+	return result;
+}
+
+/*
+* LSR - shift right, bit 0 goes into the carry and bit 7 becomes 0
+* Flags affected: N, Z, C
+*/
+static ALWAYS_INLINE uint8_t lsr(cpu_core* cpu, uint8_t value)
+{
+	uint8_t result = value >> 1;
+
+	cpu->P = (nz_flags(cpu->P, result) & ~FLAG_C) | (value & FLAG_C);
+	return result;
+}
+
+/*
+* BIT - test the bits of A against value without storing anything.
+* Z from A & value, N and V are copied from bits 7 and 6 of value.
+*/
+static ALWAYS_INLINE void bit(cpu_core* cpu, uint8_t value)
+{
+	uint8_t P = cpu->P & ~(FLAG_N | FLAG_V | FLAG_Z);
+
+	cpu->P = P | (value & (FLAG_N | FLAG_V)) | (nz_table[cpu->A & value] & FLAG_Z);
+}
+
+/* INC, DEC and friends - Flags affected: N, Z */
+static ALWAYS_INLINE uint8_t inc(cpu_core* cpu, uint8_t value)
+{
+	value += 1;
+	cpu->P = nz_flags(cpu->P, value);
+	return value;
+}
+
+static ALWAYS_INLINE uint8_t dec(cpu_core* cpu, uint8_t value)
+{
+	value -= 1;
+	cpu->P = nz_flags(cpu->P, value);
+	return value;
+}
+
+/* LDA, LDX, LDY, PLA and the transfers: the value, with N and Z set from it */
+static ALWAYS_INLINE uint8_t load(cpu_core* cpu, uint8_t value)
+{
+	cpu->P = nz_flags(cpu->P, value);
+	return value;
+}
+
+/* Push a byte onto the stack in page 1, S points at the next free slot */
+static ALWAYS_INLINE void push(cpu_core* cpu, machine* mch, uint8_t value)
+{
+	cpu_write(cpu, mch, 0x0100 | cpu->S, value);
+	cpu->S--;
+}
+
+/* Pull a byte off the stack in page 1 */
+static ALWAYS_INLINE uint8_t pull(cpu_core* cpu, machine* mch)
+{
+	cpu->S++;
+	return cpu_read(cpu, mch, 0x0100 | cpu->S);
+}
+
+#endif
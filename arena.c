@@ -0,0 +1,96 @@
+#include <stddef.h>
+#include <string.h>
+#include "machine.h"
+#include "cpu.h"
+#include "io.h"
+#include "arena.h"
+#include "graphics.h"
+#include "sound.h"
+
+#define RAM_SIZE 2048
+
+static size_t align_up(size_t offset)
+{
+	return (offset + ARENA_ALIGN - 1) & ~(size_t) (ARENA_ALIGN - 1);
+}
+
+/* Offsets of every piece of the arena for a rom with info's sizes */
+void arena_plan(const ines_info* info, arena_layout* layout)
+{
+	layout->ram = align_up(sizeof(machine));
+	layout->prg_ram = align_up(layout->ram + RAM_SIZE);
+	layout->prg_rom = align_up(layout->prg_ram + info->prg_ram_size);
+	layout->chr_rom = align_up(layout->prg_rom + info->prg_rom_size);
+	layout->size = align_up(layout->chr_rom + info->chr_rom_size);
+}
+
+/*
+* Lay a machine out in base, which has to be ARENA_ALIGN aligned and
+* zeroed up to the roms. The roms are left for the caller to fill in.
+*/
+machine* arena_init(void* base, const ines_info* info)
+{
+	machine* mch = (machine*) base;
+	arena_layout layout;
+
+	arena_plan(info, &layout);
+	mch->memory = (uint8_t*) base + layout.ram;
+	mch->prg_ram = (uint8_t*) base + layout.prg_ram;
+	mch->prg_rom = (uint8_t*) base + layout.prg_rom;
+	mch->chr_rom = (uint8_t*) base + layout.chr_rom;
+	mch->prg_rom_size = info->prg_rom_size;
+	mch->chr_rom_size = info->chr_rom_size;
+	mch->prg_ram_size = info->prg_ram_size;
+	mch->mirroring = info->mirroring;
+	return mch;
+}
+
+/*
+* Power cycle a machine built by arena_init: clear the registers and both
+* rams in one go, keep the roms. Watchpoints, the decode cache and the
+* injected input stay attached, the input played again from its first
+* frame. The renderer and the audio stay attached too, drawn and read out
+* up to the reset and then started again from the new cycle 0.
+*/
+void arena_reset(machine* mch)
+{
+	struct watch_state* watch = mch->watch;
+	struct decoded_op* decoded = mch->decoded;
+	struct renderer* render = mch->render;
+	struct audio_out* audio = mch->audio;
+	const uint8_t* input = mch->input;
+	long input_frames = mch->input_frames;
+	ines_info info;
+	arena_layout layout;
+
+	info.prg_rom_size = mch->prg_rom_size;
+	info.chr_rom_size = mch->chr_rom_size;
+	info.prg_ram_size = mch->prg_ram_size;
+	info.mirroring = mch->mirroring;
+	arena_plan(&info, &layout);
+
+	// finish off everything before the reset, at the cycle it happened
+	if (render) {
+		render_sync(render, mch->cpu.cycle);
+	}
+	if (audio) {
+		audio_sync(audio, mch->cpu.cycle);
+	}
+
+	memset(mch, 0, layout.prg_rom);
+	arena_init(mch, &info);
+	mch->watch = watch;
+	mch->decoded = decoded;
+	mch->render = render;
+	mch->audio = audio;
+	mch->input = input;
+	mch->input_frames = input_frames;
+	power_on(mch);
+
+	if (render) {
+		render_reset(render, mch->cpu.cycle);
+	}
+	if (audio) {
+		audio_reset(audio, mch->cpu.cycle);
+	}
+}
@@ -0,0 +1,39 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+#include "machine.h"
+#include "io.h"
+
+#define ARENA_ALIGN 64 // cache line
+
+/*
+* A machine and everything it points at live in one block, each piece
+* starting on a cache line:
+*
+*   0        machine, registers first so they share the first line
+*   ram      2KB of cpu ram
+*   prg_ram  prg_ram_size bytes of cartridge ram
+*   prg_rom  prg_rom_size bytes
+*   chr_rom  chr_rom_size bytes
+*   size     end of the block
+*
+* Everything before prg_rom changes as the machine runs, everything after
+* it is the cartridge, so a reset clears the first part with one memset.
+* The pointers to what the machine does not own survive it: watchpoints,
+* the decode cache, the renderer, the audio and the injected input, which
+* plays again from its first frame.
+*/
+typedef struct arena_layout {
+	size_t ram;
+	size_t prg_ram;
+	size_t prg_rom;
+	size_t chr_rom;
+	size_t size;
+} arena_layout;
+
+void arena_plan(const ines_info* info, arena_layout* layout);
+machine* arena_init(void* base, const ines_info* info);
+void arena_reset(machine* mch);
+
+#endif
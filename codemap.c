@@ -0,0 +1,308 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include "machine.h"
+#include "optable.h"
+#include "hash.h"
+#include "codemap.h"
+
+#define MAX_TABLE 128 // entries followed in one jump table
+#define PRG_BANK 0x4000 // ines counts prg rom in 16KB banks, at most 255 of them
+
+#define OP_BRK 0x00
+#define OP_JSR 0x20
+#define OP_RTI 0x40
+#define OP_PHA 0x48
+#define OP_JMP_ABS 0x4C
+#define OP_RTS 0x60
+#define OP_JMP_IND 0x6C
+
+typedef struct analysis {
+	machine* mch;
+	code_map* map;
+	uint16_t* queue;
+	int num_queued;
+	uint8_t queued[0x10000 / 8];
+} analysis;
+
+// same mirroring as the page table, a single 16KB bank shows up twice
+static uint32_t rom_offset(analysis* an, uint16_t address)
+{
+	return (address - 0x8000) % an->map->header.size;
+}
+
+static uint8_t rom_byte(analysis* an, uint16_t address)
+{
+	return an->mch->prg_rom[rom_offset(an, address)];
+}
+
+static void enqueue(analysis* an, uint16_t address)
+{
+	if (address < 0x8000 || (an->queued[address >> 3] & (1 << (address & 7)))) {
+		return;
+	}
+	an->queued[address >> 3] |= 1 << (address & 7);
+	an->queue[an->num_queued++] = address;
+}
+
+// is a byte of rom free to be marked as kind, or marked so already
+static int can_mark(analysis* an, uint16_t address, uint8_t kind)
+{
+	uint8_t current;
+
+	if (address < 0x8000) {
+		return 0;
+	}
+	current = an->map->kind[rom_offset(an, address)];
+	return current == MAP_UNKNOWN || current == kind;
+}
+
+/*
+* Follow a table of addresses, split into lo and hi halves or interleaved
+* when hi is lo + 1, and queue every entry. Stops at the first entry that
+* runs into code, leaves rom, or runs into the other half of the table.
+* rts is set for tables used by pushing the address - 1 and returning.
+*/
+static void follow_table(analysis* an, uint16_t lo, uint16_t hi, char rts)
+{
+	int stride = hi == lo + 1 ? 2 : 1;
+	int i;
+
+	for (i = 0; i < MAX_TABLE; i++) {
+		uint16_t lo_at = lo + i * stride, hi_at = hi + i * stride;
+		uint16_t target;
+
+		if (stride == 1 && i > 0 && (lo_at == hi || hi_at == lo)) {
+			return;
+		}
+		if (!can_mark(an, lo_at, MAP_DATA) || !can_mark(an, hi_at, MAP_DATA)) {
+			return;
+		}
+
+		target = (rom_byte(an, lo_at) | ((uint16_t) rom_byte(an, hi_at) << 8)) + rts;
+		if (target < 0x8000 || opcode_table[rom_byte(an, target)].mnemonic[0] == '?') {
+			return;
+		}
+
+		an->map->kind[rom_offset(an, lo_at)] = MAP_DATA;
+		an->map->kind[rom_offset(an, hi_at)] = MAP_DATA;
+		enqueue(an, target);
+	}
+}
+
+/* Queue the one address in the vector at address, the two bytes being data */
+static void follow_vector(analysis* an, uint16_t address)
+{
+	uint16_t target;
+
+	if (!can_mark(an, address, MAP_DATA) || !can_mark(an, address + 1, MAP_DATA)) {
+		return;
+	}
+
+	target = rom_byte(an, address) | ((uint16_t) rom_byte(an, address + 1) << 8);
+	an->map->kind[rom_offset(an, address)] = MAP_DATA;
+	an->map->kind[rom_offset(an, address + 1)] = MAP_DATA;
+	enqueue(an, target);
+}
+
+/*
+* Mark instructions from address on until control flow leaves for good.
+* The last two indexed loads from rom are remembered as the likely halves
+* of a jump table, for the two usual idioms:
+*   lda lo,x / sta ptr / lda hi,x / sta ptr+1 / jmp (ptr)
+*   lda hi,x / pha / lda lo,x / pha / rts
+*/
+static void walk(analysis* an, uint16_t address)
+{
+	uint16_t tables[2] = {0, 0};
+	int num_tables = 0;
+	int pushes = 0;
+
+	for (;;) {
+		const opcode_info* info;
+		uint16_t operand;
+		uint8_t op;
+		int i;
+
+		if (address < 0x8000 || an->map->kind[rom_offset(an, address)] != MAP_UNKNOWN) {
+			return;
+		}
+
+		op = rom_byte(an, address);
+		info = &opcode_table[op];
+		if (info->mnemonic[0] == '?' || strcmp(info->mnemonic, "KIL") == 0) {
+			return;
+		}
+		for (i = 1; i < info->length; i++) {
+			if (!can_mark(an, address + i, MAP_UNKNOWN)) {
+				return;
+			}
+		}
+
+		an->map->kind[rom_offset(an, address)] = MAP_CODE;
+		for (i = 1; i < info->length; i++) {
+			an->map->kind[rom_offset(an, address + i)] = MAP_OPERAND;
+		}
+
+		operand = info->length == 3 ? rom_byte(an, address + 1) | ((uint16_t) rom_byte(an, address + 2) << 8) : rom_byte(an, address + 1);
+		address += info->length;
+
+		if (info->mode == MODE_REL) {
+			enqueue(an, address + (int8_t) operand);
+			continue;
+		}
+
+		if ((info->mode == MODE_ABSX || info->mode == MODE_ABSY) && info->mnemonic[0] == 'L' && operand >= 0x8000) {
+			tables[0] = num_tables ? tables[1] : operand;
+			tables[1] = operand;
+			num_tables = num_tables < 2 ? num_tables + 1 : 2;
+		}
+
+		switch (op) {
+			case OP_PHA:
+				pushes++;
+				break;
+			case OP_JSR:
+				enqueue(an, operand);
+				break;
+			case OP_JMP_ABS:
+				enqueue(an, operand);
+				return;
+			case OP_JMP_IND:
+				if (operand >= 0x8000) {
+					// a fixed vector in rom, one target and no table
+					follow_vector(an, operand);
+				} else if (num_tables == 2) {
+					follow_table(an, tables[0], tables[1], 0);
+				}
+				return;
+			case OP_RTS:
+				if (num_tables == 2 && pushes >= 2) {
+					follow_table(an, tables[1], tables[0], 1);
+				}
+				return;
+			case OP_RTI:
+			case OP_BRK:
+				return;
+		}
+	}
+}
+
+/* Analyse the rom of a loaded machine. Returns NULL if out of memory. */
+code_map* code_map_create(machine* mch)
+{
+	code_map* map = (code_map*) calloc(1, sizeof(code_map));
+	analysis* an = (analysis*) calloc(1, sizeof(analysis));
+	static const uint16_t vectors[3] = {0xFFFA, 0xFFFC, 0xFFFE}; // nmi, reset, irq
+	int i;
+
+	if (!map || !an) {
+		free(map);
+		free(an);
+		return NULL;
+	}
+
+	map->header.magic = CODEMAP_MAGIC;
+	map->header.size = mch->prg_rom_size;
+	map->header.rom_hash = rom_hash(mch);
+	map->kind = (uint8_t*) calloc(mch->prg_rom_size + 1, 1);
+	an->queue = (uint16_t*) malloc(0x10000 * sizeof(uint16_t));
+
+	if (!map->kind || !an->queue) {
+		code_map_destroy(map);
+		free(an->queue);
+		free(an);
+		return NULL;
+	}
+
+	an->mch = mch;
+	an->map = map;
+
+	if (mch->prg_rom_size) {
+		for (i = 0; i < 3; i++) {
+			enqueue(an, rom_byte(an, vectors[i]) | ((uint16_t) rom_byte(an, vectors[i] + 1) << 8));
+		}
+		while (an->num_queued) {
+			walk(an, an->queue[--an->num_queued]);
+		}
+	}
+
+	free(an->queue);
+	free(an);
+	return map;
+}
+
+void code_map_destroy(code_map* map)
+{
+	if (map) {
+		free(map->kind);
+		free(map);
+	}
+}
+
+/* Returns 0 on success */
+int code_map_save(code_map* map, FILE* fp)
+{
+	if (fwrite(&map->header, sizeof(code_map_header), 1, fp) != 1) {
+		return -1;
+	}
+	if (fwrite(map->kind, 1, map->header.size, fp) != map->header.size) {
+		return -1;
+	}
+	return 0;
+}
+
+/*
+* A size no rom has, or more bytes than the file holds after the header.
+* Files that cannot be measured, like pipes, are left to fread.
+*/
+static int bad_size(FILE* fp, uint32_t size)
+{
+	struct stat st;
+
+	if (size == 0 || size % PRG_BANK != 0 || size > 255 * PRG_BANK) {
+		return 1;
+	}
+	if (fstat(fileno(fp), &st) == 0 && S_ISREG(st.st_mode) && (uint64_t) st.st_size < sizeof(code_map_header) + (uint64_t) size) {
+		return 1;
+	}
+	return 0;
+}
+
+/* Returns NULL if the file is not a code map, is truncated, or has a bad size */
+code_map* code_map_load(FILE* fp)
+{
+	code_map* map = (code_map*) calloc(1, sizeof(code_map));
+	uint32_t i;
+
+	if (!map) {
+		return NULL;
+	}
+
+	if (fread(&map->header, sizeof(code_map_header), 1, fp) != 1 || map->header.magic != CODEMAP_MAGIC) {
+		free(map);
+		return NULL;
+	}
+
+	if (bad_size(fp, map->header.size)) {
+		free(map);
+		return NULL;
+	}
+
+	map->kind = (uint8_t*) malloc((size_t) map->header.size + 1);
+	if (!map->kind || fread(map->kind, 1, map->header.size, fp) != map->header.size) {
+		code_map_destroy(map);
+		return NULL;
+	}
+
+	for (i = 0; i < map->header.size; i++) {
+		if (map->kind[i] > MAP_DATA) {
+			code_map_destroy(map);
+			return NULL;
+		}
+	}
+
+	return map;
+}
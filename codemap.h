@@ -0,0 +1,47 @@
+#ifndef CODEMAP_H
+#define CODEMAP_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include "machine.h"
+
+#define CODEMAP_MAGIC 0x3150414D // "MAP1"
+
+// what a byte of prg rom was found to be
+#define MAP_UNKNOWN 0 // never reached, most likely data
+#define MAP_CODE 1 // first byte of an instruction
+#define MAP_OPERAND 2 // operand byte of an instruction
+#define MAP_DATA 3 // entry of a jump table
+
+/*
+* One kind per byte of prg rom, found by following control flow from the
+* reset, NMI and IRQ vectors. Code that only runs from ram, or is only
+* reached through a computed jump the heuristics miss, stays MAP_UNKNOWN,
+* so anything that skips unknown bytes has to cope with a miss.
+*/
+typedef struct code_map_header {
+	uint32_t magic;
+	uint32_t size; // prg_rom_size of the rom
+	uint64_t rom_hash;
+} code_map_header;
+
+typedef struct code_map {
+	code_map_header header;
+	uint8_t* kind;
+} code_map;
+
+code_map* code_map_create(machine* mch);
+void code_map_destroy(code_map* map);
+int code_map_save(code_map* map, FILE* fp);
+code_map* code_map_load(FILE* fp);
+
+/* Kind of the byte behind a cpu address, MAP_UNKNOWN outside of rom */
+static inline uint8_t code_map_at(const code_map* map, uint16_t address)
+{
+	if (address < 0x8000 || map->header.size == 0) {
+		return MAP_UNKNOWN;
+	}
+	return map->kind[(address - 0x8000) % map->header.size];
+}
+
+#endif
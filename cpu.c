@@ -0,0 +1,320 @@
+/*
+* The cpu core as a single translation unit. opcodes.c is included rather
+* than linked so the dispatcher sees every handler, and alu.h makes the
+* primitives and handlers static inline, so a plain -O2 build can inline
+* whole instructions into the loop in run. Build this file instead of
+* opcodes.c.
+*/
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include "machine.h"
+#include "cpu.h"
+#include "optable.h"
+#include "disasm.h"
+#include "decode.h"
+#include "graphics.h"
+#include "sound.h"
+#include "opcodes.c"
+
+/* Stop the cpu on the opcode just fetched, leaving pc on it */
+static void stop_cpu(cpu_core* cpu, uint8_t length, uint8_t status)
+{
+	cpu->pc -= length;
+	cpu->status = status;
+}
+
+/* Run a superinstruction from the decode cache, see fuse_ops */
+static ALWAYS_INLINE void dispatch_fused(const decoded_op* op, cpu_core* cpu, machine* mch)
+{
+	switch (op->fused) {
+		case FUSE_DEX_BNE: return fused_dec_bne(op, cpu, mch, 0);
+		case FUSE_DEY_BNE: return fused_dec_bne(op, cpu, mch, 1);
+		case FUSE_INX_CPX_BNE: return fused_inx_cpx_bne(op, cpu, mch);
+		case FUSE_CLC_ADC_IMM: return fused_clc_adc(op, cpu, mch, 0);
+		case FUSE_CLC_ADC_ZP: return fused_clc_adc(op, cpu, mch, 1);
+		case FUSE_SEC_SBC_IMM: return fused_sec_sbc(op, cpu, mch, 0);
+		case FUSE_SEC_SBC_ZP: return fused_sec_sbc(op, cpu, mch, 1);
+		case FUSE_LDA_IMM_STA_ABS: return fused_lda_imm_sta_abs(op, cpu, mch);
+		case FUSE_LDA_STA_ZP: return fused_lda_sta_zp(op, cpu, mch);
+		case FUSE_LDA_STA_ABSX: return fused_lda_sta_absx(op, cpu, mch);
+		case FUSE_LDA_STA_ABSY: return fused_lda_sta_absy(op, cpu, mch);
+		case FUSE_LDA_STA_INDY: return fused_lda_sta_indy(op, cpu, mch);
+		case FUSE_IDLE: return fused_idle(op, cpu, mch);
+	}
+}
+
+/*
+* Decode and run the instruction at pc. Only the operand bytes opcode_table says the
+* instruction has are read, and pc is moved past them before the handler
+* runs, so handlers see pc on the next instruction and jumps just set it.
+* Rom instructions come out of the decode cache when one is attached, and
+* go into it the first time they are fetched the slow way. With fuse set,
+* a cached instruction that starts a superinstruction runs it instead;
+* traces (DEBUG) and single steps always see one instruction at a time.
+*/
+static ALWAYS_INLINE void dispatch(cpu_core* cpu, machine* mch, char fuse)
+{
+	uint8_t opcode[3] = {0};
+	uint8_t length;
+	decoded_op* ops = mch->decode_page[cpu->pc >> 8];
+	decoded_op* op = ops ? &ops[cpu->pc & 0xFF] : NULL;
+
+	if (op && op->length) {
+		opcode[0] = op->opcode;
+		opcode[1] = op->operand[0];
+		opcode[2] = op->operand[1];
+		length = op->length;
+		if (fuse && !DEBUG && op->fused != FUSE_NONE) {
+			if (op->fused == FUSE_UNCHECKED) {
+				op->fused = fuse_ops(op, 0x100 - (cpu->pc & 0xFF));
+			}
+			if (op->fused > FUSE_NONE) {
+				cpu->pc += length;
+				return dispatch_fused(op, cpu, mch);
+			}
+		}
+	} else {
+		opcode[0] = cpu_fetch(cpu, mch, cpu->pc);
+		length = opcode_table[opcode[0]].length;
+		if (length > 1) {
+			opcode[1] = cpu_read(cpu, mch, cpu->pc + 1);
+		}
+		if (length > 2) {
+			opcode[2] = cpu_read(cpu, mch, cpu->pc + 2);
+		}
+		if (op && (cpu->pc & 0xFF) + length <= 0x100) {
+			op->opcode = opcode[0];
+			op->operand[0] = opcode[1];
+			op->operand[1] = opcode[2];
+			op->length = length;
+		}
+	}
+
+	if (DEBUG) {
+		char text[DISASM_MAX];
+		disassemble(opcode, length, cpu->pc, text);
+		fprintf(stdout, "%04X  %s\n", cpu->pc, text);
+	}
+
+	cpu->pc += length;
+
+	switch(*opcode) {
+		case 0x02:
+		case 0x12:
+		case 0x22:
+		case 0x32:
+		case 0x42:
+		case 0x52:
+		case 0x62:
+		case 0x72:
+		case 0x92:
+		case 0xB2:
+		case 0xD2:
+		case 0xF2: return stop_cpu(cpu, length, CPU_JAMMED);
+		case 0xEA: return nop(cpu, mch, 1);
+		case 0x1A: return nop(cpu, mch, 2); // illegal instruction (nop with 2 cycles)
+		case 0x7A: return nop(cpu, mch, 2); // same as above
+		case 0x69: return adc_imm(opcode[1], cpu, mch);
+		case 0x65: return adc_zp(opcode[1], cpu, mch);
+		case 0x75: return adc_zpx(opcode[1], cpu, mch);
+		case 0x6D: return adc_abs(opcode[2], opcode[1], cpu, mch);
+		case 0x7D: return adc_absx(opcode[2], opcode[1], cpu, mch);
+		case 0x79: return adc_absy(opcode[2], opcode[1], cpu, mch);
+		case 0x61: return adc_indx(opcode[1], cpu, mch);
+		case 0x71: return adc_indy(opcode[1], cpu, mch);
+		case 0xE9: return sbc_imm(opcode[1], cpu, mch);
+		case 0xE5: return sbc_zp(opcode[1], cpu, mch);
+		case 0xF5: return sbc_zpx(opcode[1], cpu, mch);
+		case 0xED: return sbc_abs(opcode[2], opcode[1], cpu, mch);
+		case 0xFD: return sbc_absx(opcode[2], opcode[1], cpu, mch);
+		case 0xF9: return sbc_absy(opcode[2], opcode[1], cpu, mch);
+		case 0xE1: return sbc_indx(opcode[1], cpu, mch);
+		case 0xF1: return sbc_indy(opcode[1], cpu, mch);
+		case 0x29: return and_imm(opcode[1], cpu, mch);
+		case 0x25: return and_zp(opcode[1], cpu, mch);
+		case 0x35: return and_zpx(opcode[1], cpu, mch);
+		case 0x2D: return and_abs(opcode[2], opcode[1], cpu, mch);
+		case 0x3D: return and_absx(opcode[2], opcode[1], cpu, mch);
+		case 0x39: return and_absy(opcode[2], opcode[1], cpu, mch);
+		case 0x21: return and_indx(opcode[1], cpu, mch);
+		case 0x31: return and_indy(opcode[1], cpu, mch);
+		case 0x0A: return asl_acc(cpu, mch);
+		case 0x06: return asl_zp(opcode[1], cpu, mch);
+		case 0x16: return asl_zpx(opcode[1], cpu, mch);
+		case 0x0E: return asl_abs(opcode[2], opcode[1], cpu, mch);
+		case 0x1E: return asl_absx(opcode[2], opcode[1], cpu, mch);
+		case 0x90: return branch_clear(opcode[1], cpu, mch, 0b00000001);
+		case 0xB0: return branch_set(opcode[1], cpu, mch, 0b00000001);
+		case 0xF0: return branch_set(opcode[1], cpu, mch, 0b00000010);
+		case 0x24: return bit_zp(opcode[1], cpu, mch);
+		case 0x2C: return bit_abs(opcode[2], opcode[1], cpu, mch);
+		case 0x30: return branch_set(opcode[1], cpu, mch, 0b10000000);
+		case 0xD0: return branch_clear(opcode[1], cpu, mch, 0b00000010);
+		case 0x10: return branch_clear(opcode[1], cpu, mch, 0b10000000);
+		case 0x00: return brk(cpu, mch);
+		case 0x50: return branch_clear(opcode[1], cpu, mch, 0b01000000);
+		case 0x70: return branch_set(opcode[1], cpu, mch, 0b01000000);
+		case 0x18: return clc(cpu, mch);
+		case 0xD8: return cld(cpu, mch);
+		case 0x58: return cli(cpu, mch);
+		case 0xB8: return clv(cpu, mch);
+		case 0xC9: return cmp_imm(opcode[1], cpu, mch);
+		case 0xC5: return cmp_zp(opcode[1], cpu, mch);
+		case 0xD5: return cmp_zpx(opcode[1], cpu, mch);
+		case 0xCD: return cmp_abs(opcode[2], opcode[1], cpu, mch, 0, 0);
+		case 0xDD: return cmp_abs(opcode[2], opcode[1], cpu, mch, 1, cpu->X);
+		case 0xD9: return cmp_abs(opcode[2], opcode[1], cpu, mch, 1, cpu->Y);
+		case 0xC1: return cmp_indx(opcode[1], cpu, mch);
+		case 0xD1: return cmp_indy(opcode[1], cpu, mch);
+		case 0xE0: return cpx_imm(opcode[1], cpu, mch);
+		case 0xE4: return cpx_zp(opcode[1], cpu, mch);
+		case 0xEC: return cpx_abs(opcode[2], opcode[1], cpu, mch);
+		case 0xC0: return cpy_imm(opcode[1], cpu, mch);
+		case 0xC4: return cpy_zp(opcode[1], cpu, mch);
+		case 0xCC: return cpy_abs(opcode[2], opcode[1], cpu, mch);
+		case 0xC6: return dec_zp(opcode[1], cpu, mch);
+		case 0xD6: return dec_zpx(opcode[1], cpu, mch);
+		case 0xCE: return dec_abs(opcode[2], opcode[1], cpu, mch);
+		case 0xDE: return dec_absx(opcode[2], opcode[1], cpu, mch);
+		case 0xCA: return dex(cpu, mch);
+		case 0x88: return dey(cpu, mch);
+		case 0x49: return eor_imm(opcode[1], cpu, mch);
+		case 0x45: return eor_zp(opcode[1], cpu, mch);
+		case 0x55: return eor_zpx(opcode[1], cpu, mch);
+		case 0x4D: return eor_abs(opcode[2], opcode[1], cpu, mch);
+		case 0x5D: return eor_absx(opcode[2], opcode[1], cpu, mch);
+		case 0x59: return eor_absy(opcode[2], opcode[1], cpu, mch);
+		case 0x41: return eor_indx(opcode[1], cpu, mch);
+		case 0x51: return eor_indy(opcode[1], cpu, mch);
+		case 0xE6: return inc_zp(opcode[1], cpu, mch, 0, 0);
+		case 0xF6: return inc_zp(opcode[1], cpu, mch, 1, cpu->X);
+		case 0xEE: return inc_abs(opcode[2], opcode[1], cpu, mch, 0, 0);
+		case 0xFE: return inc_abs(opcode[2], opcode[1], cpu, mch, 1, cpu->X);
+		case 0xE8: return inx(cpu, mch);
+		case 0xC8: return iny(cpu, mch);
+		case 0x4C: return jmp_abs(opcode[2], opcode[1], cpu, mch);
+		case 0x6C: return jmp_ind(opcode[2], opcode[1], cpu, mch);
+		case 0x20: return jsr(opcode[2], opcode[1], cpu, mch);
+		case 0xA9: return lda_imm(opcode[1], cpu, mch);
+		case 0xA5: return lda_zp(opcode[1], cpu, mch, 0, 0);
+		case 0xB5: return lda_zp(opcode[1], cpu, mch, 1, cpu->X);
+		case 0xAD: return lda_abs(opcode[2], opcode[1], cpu, mch, 0, 0);
+		case 0xBD: return lda_abs(opcode[2], opcode[1], cpu, mch, 1, cpu->X);
+		case 0xB9: return lda_abs(opcode[2], opcode[1], cpu, mch, 1, cpu->Y);
+		case 0xA1: return lda_indx(opcode[1], cpu, mch);
+		case 0xB1: return lda_indy(opcode[1], cpu, mch);
+		case 0xA2: return ldx_imm(opcode[1], cpu, mch);
+		case 0xA6: return ldx_zp(opcode[1], cpu, mch, 0, 0);
+		case 0xB6: return ldx_zp(opcode[1], cpu, mch, 1, cpu->Y);
+		case 0xAE: return ldx_abs(opcode[2], opcode[1], cpu, mch, 0, 0);
+		case 0xBE: return ldx_abs(opcode[2], opcode[1], cpu, mch, 1, cpu->Y);
+		case 0xA0: return ldy_imm(opcode[1], cpu, mch);
+		case 0xA4: return ldy_zp(opcode[1], cpu, mch, 0, 0);
+		case 0xB4: return ldy_zp(opcode[1], cpu, mch, 1, cpu->X);
+		case 0xAC: return ldy_abs(opcode[2], opcode[1], cpu, mch, 0, 0);
+		case 0xBC: return ldy_abs(opcode[2], opcode[1], cpu, mch, 1, cpu->X);
+		case 0x4A: return lsr_acc(cpu, mch);
+		case 0x46: return lsr_zp(opcode[1], cpu, mch);
+		case 0x56: return lsr_zpx(opcode[1], cpu, mch);
+		case 0x4E: return lsr_abs(opcode[2], opcode[1], cpu, mch);
+		case 0x5E: return lsr_absx(opcode[2], opcode[1], cpu, mch);
+		case 0x09: return or_imm(opcode[1], cpu, mch);
+		case 0x05: return or_zp(opcode[1], cpu, mch);
+		case 0x15: return or_zpx(opcode[1], cpu, mch);
+		case 0x0D: return or_abs(opcode[2], opcode[1], cpu, mch);
+		case 0x1D: return or_absx(opcode[2], opcode[1], cpu, mch);
+		case 0x19: return or_absy(opcode[2], opcode[1], cpu, mch);
+		case 0x01: return or_indx(opcode[1], cpu, mch);
+		case 0x11: return or_indy(opcode[1], cpu, mch);
+		case 0x48: return pha(cpu, mch);
+		case 0x08: return php(cpu, mch);
+		case 0x68: return pla(cpu, mch);
+		case 0x28: return plp(cpu, mch);
+		case 0x40: return rti(cpu, mch);
+		case 0x60: return rts(cpu, mch);
+		case 0x78: return sei(cpu, mch); 
+		case 0x38: return sec(cpu, mch);
+		case 0xF8: return sed(cpu, mch);
+		case 0xAA: return tax(cpu, mch);
+		case 0xA8: return tay(cpu, mch);
+		case 0x8A: return txa(cpu, mch);
+		case 0x98: return tya(cpu, mch);
+		case 0x85: return sta_zp(opcode[1], cpu, mch);
+		case 0x95: return sta_zpx(opcode[1], cpu, mch);
+		case 0x8D: return sta_abs(opcode[2], opcode[1], cpu, mch);
+		case 0x9D: return sta_absx(opcode[2], opcode[1], cpu, mch);
+		case 0x99: return sta_absy(opcode[2], opcode[1], cpu, mch);
+		case 0x81: return sta_indx(opcode[1], cpu, mch);
+		case 0x91: return sta_indy(opcode[1], cpu, mch);
+		case 0x86: return stx_zp(opcode[1], cpu, mch, 0, 0);
+		case 0x96: return stx_zp(opcode[1], cpu, mch, 1, cpu->Y);
+		case 0x8E: return stx_abs(opcode[2], opcode[1], cpu, mch);
+		case 0x84: return sty_zp(opcode[1], cpu, mch, 0, 0);
+		case 0x94: return sty_zp(opcode[1], cpu, mch, 1, cpu->X);
+		case 0x8C: return sty_abs(opcode[2], opcode[1], cpu, mch);
+
+		default: return stop_cpu(cpu, length, CPU_BAD_OPCODE);
+	}
+}
+
+/*
+* The interpreter loop. The registers live in a local copy of the
+* cpu_core for the whole run, so the compiler can keep them in host
+* registers instead of going back to the machine after every store
+* through a page pointer (a uint8_t store may alias anything whose
+* address has been taken). The copy is written back when the loop
+* exits and around the slow memory paths, see cpu_read.
+*/
+static void run(machine* mch, char once)
+{
+	cpu_core cpu;
+
+	cpu_copy(&cpu, &mch->cpu);
+	mch->idle.cycle = -1; // memory may have changed since the last run
+	do {
+		dispatch(&cpu, mch, !once);
+	} while (!once && cpu.cycle < cpu.deadline && cpu.status == CPU_RUNNING);
+
+	cpu_copy(&mch->cpu, &cpu);
+}
+
+/* Run the instruction at pc */
+void execute_cpu(machine* mch)
+{
+	run(mch, 1);
+}
+
+/*
+* Run whole instructions until the cycle count reaches until or the cpu
+* stops. Instructions may pull cpu.deadline in to return early. The
+* renderer and the audio, if any, are told how far the cpu got.
+*/
+void run_cpu(machine* mch, int64_t until)
+{
+	mch->cpu.deadline = until;
+	if (mch->cpu.cycle < until && mch->cpu.status == CPU_RUNNING) {
+		run(mch, 0);
+	}
+	if (mch->render) {
+		render_sync(mch->render, mch->cpu.cycle);
+	}
+	if (mch->audio) {
+		audio_sync(mch->audio, mch->cpu.cycle);
+	}
+}
+
+/* Registers as they are after power on, starting at the reset vector */
+void power_on(machine* mch)
+{
+	mch->cpu.A = 0;
+	mch->cpu.X = 0;
+	mch->cpu.Y = 0;
+	mch->cpu.P = 0b00100000; // bit 5 is 1 at all times
+	mch->cpu.S = 0xFD; // where the stack pointer ends up after reset
+	mch->cpu.cycle = 0;
+	mch->cpu.deadline = 0;
+	mch->cpu.status = CPU_RUNNING;
+	map_pages(mch);
+	mch->cpu.pc = read_mem(mch, 0xFFFC) | ((uint16_t) read_mem(mch, 0xFFFD) << 8);
+}
@@ -0,0 +1,15 @@
+#ifndef CPU_H
+#define CPU_H
+
+#include "machine.h"
+
+// machine.status, why the cpu stopped
+#define CPU_RUNNING 0
+#define CPU_JAMMED 1 // ran a KIL opcode
+#define CPU_BAD_OPCODE 2 // ran an opcode the core does not implement
+
+void execute_cpu(machine* mch);
+void run_cpu(machine* mch, int64_t until);
+void power_on(machine* mch);
+
+#endif
@@ -0,0 +1,267 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "machine.h"
+#include "optable.h"
+#include "codemap.h"
+#include "hash.h"
+#include "decode.h"
+
+typedef struct fusion {
+	uint8_t opcodes[3];
+	uint8_t count;
+	uint8_t fused;
+} fusion;
+
+// idioms run as one handler, see the fused_ handlers in opcodes.c
+static const fusion fusions[] = {
+	{{0xCA, 0xD0}, 2, FUSE_DEX_BNE},
+	{{0x88, 0xD0}, 2, FUSE_DEY_BNE},
+	{{0xE8, 0xE0, 0xD0}, 3, FUSE_INX_CPX_BNE},
+	{{0x18, 0x69}, 2, FUSE_CLC_ADC_IMM},
+	{{0x18, 0x65}, 2, FUSE_CLC_ADC_ZP},
+	{{0x38, 0xE9}, 2, FUSE_SEC_SBC_IMM},
+	{{0x38, 0xE5}, 2, FUSE_SEC_SBC_ZP},
+	{{0xA9, 0x8D}, 2, FUSE_LDA_IMM_STA_ABS},
+	{{0xA5, 0x85}, 2, FUSE_LDA_STA_ZP},
+	{{0xBD, 0x9D}, 2, FUSE_LDA_STA_ABSX},
+	{{0xB9, 0x99}, 2, FUSE_LDA_STA_ABSY},
+	{{0xB1, 0x91}, 2, FUSE_LDA_STA_INDY},
+};
+
+/*
+* Instructions that change nothing but registers and flags, and so could
+* spin forever polling memory. Reads of the controllers shift them out,
+* and reads of 0x2007 move the ppu's vram address.
+*/
+static int reads_only(const decoded_op* op)
+{
+	uint16_t address = op->operand[0] | ((uint16_t) op->operand[1] << 8);
+
+	switch (op->opcode) {
+		case 0xAD: case 0xAE: case 0xAC: // lda, ldx, ldy
+		case 0xCD: case 0xEC: case 0xCC: // cmp, cpx, cpy
+		case 0x2D: case 0x0D: case 0x4D: // and, ora, eor
+		case 0x2C: // bit
+			if ((address & 0xE007) == 0x2007) {
+				return 0;
+			}
+			return address < 0x4000 || address >= 0x4020;
+		case 0xA9: case 0xA5: case 0xA2: case 0xA6: case 0xA0: case 0xA4:
+		case 0xC9: case 0xC5: case 0xE0: case 0xE4: case 0xC0: case 0xC4:
+		case 0x29: case 0x25: case 0x09: case 0x05: case 0x49: case 0x45:
+		case 0x24:
+		case 0x18: case 0x38: case 0xB8: // clc, sec, clv
+		case 0xAA: case 0xA8: case 0x8A: case 0x98:
+		case 0xEA:
+			return 1;
+	}
+	return 0;
+}
+
+/*
+* A branch or jmp at offset at of its page going back to a loop of
+* reads_only instructions, such as lda $2002 / bpl, or jmp to itself.
+* A jmp is matched on its low byte, fused_idle checks the page.
+*/
+static uint8_t fuse_idle(const decoded_op* page, int at)
+{
+	const decoded_op* op = &page[at];
+	int top = op->opcode == 0x4C ? op->operand[0] : at + 2 + (int8_t) op->operand[0];
+	int i;
+
+	if (top < 0 || top > at) {
+		return FUSE_NONE;
+	}
+
+	for (i = top; i < at; i += page[i].length) {
+		if (page[i].length == 0) {
+			return FUSE_UNCHECKED;
+		}
+		if (!reads_only(&page[i])) {
+			return FUSE_NONE;
+		}
+	}
+
+	return i == at ? FUSE_IDLE : FUSE_NONE;
+}
+
+/*
+* The superinstruction starting at the decoded op, which has room bytes
+* of its page left from op on. Like single instructions, a fused one never
+* leaves its page. Returns FUSE_UNCHECKED while a possible match depends
+* on instructions that have not been decoded yet, so it is tried again
+* once they have.
+*/
+uint8_t fuse_ops(const decoded_op* op, int room)
+{
+	uint8_t result = FUSE_NONE;
+	size_t i;
+
+	if ((op->opcode & 0x1F) == 0x10 || op->opcode == 0x4C) { // branches, and jmp abs
+		return fuse_idle(op - (0x100 - room), 0x100 - room);
+	}
+
+	for (i = 0; i < sizeof(fusions) / sizeof(fusions[0]); i++) {
+		const fusion* f = &fusions[i];
+		int at = 0, j;
+
+		for (j = 0; j < f->count; j++) {
+			if (at >= room) {
+				break;
+			}
+			if (op[at].length == 0) {
+				result = FUSE_UNCHECKED;
+				break;
+			}
+			if (op[at].opcode != f->opcodes[j]) {
+				break;
+			}
+			at += op[at].length;
+		}
+
+		if (j == f->count && at <= room) {
+			return f->fused;
+		}
+	}
+
+	return result;
+}
+
+/*
+* Decode every instruction the code map found. Data and unknown bytes are
+* left for execute_cpu to decode if they ever run. Returns NULL if out of
+* memory.
+*/
+decode_cache* decode_cache_create(machine* mch, const code_map* map)
+{
+	decode_cache* cache = (decode_cache*) calloc(1, sizeof(decode_cache));
+	uint32_t offset;
+
+	if (!cache) {
+		return NULL;
+	}
+
+	cache->header = (decode_header*) calloc(1, sizeof(decode_header) + (size_t) mch->prg_rom_size * sizeof(decoded_op));
+	if (!cache->header) {
+		free(cache);
+		return NULL;
+	}
+
+	cache->header->magic = DECODE_MAGIC;
+	cache->header->size = mch->prg_rom_size;
+	cache->header->rom_hash = rom_hash(mch);
+	cache->header->bank_size = DECODE_BANK_SIZE;
+	cache->header->num_banks = mch->prg_rom_size / DECODE_BANK_SIZE;
+	cache->ops = (decoded_op*) (cache->header + 1);
+
+	for (offset = 0; map && offset < map->header.size && offset < cache->header->size; offset++) {
+		decoded_op* op = &cache->ops[offset];
+		uint8_t length;
+
+		if (map->kind[offset] != MAP_CODE) {
+			continue;
+		}
+
+		length = opcode_table[mch->prg_rom[offset]].length;
+		if ((offset & 0xFF) + length > 0x100) {
+			continue;
+		}
+
+		op->opcode = mch->prg_rom[offset];
+		op->length = length;
+		op->operand[0] = length > 1 ? mch->prg_rom[offset + 1] : 0;
+		op->operand[1] = length > 2 ? mch->prg_rom[offset + 2] : 0;
+	}
+
+	for (offset = 0; offset < cache->header->size; offset++) {
+		if (cache->ops[offset].length) {
+			cache->ops[offset].fused = fuse_ops(&cache->ops[offset], 0x100 - (offset & 0xFF));
+		}
+	}
+
+	return cache;
+}
+
+/*
+* Map a cache file written by decode_cache_save. The mapping is private,
+* so instructions decoded while running stay in this process. Returns NULL
+* if the file is missing, or was written for another rom.
+*/
+decode_cache* decode_cache_open(machine* mch, const char* path)
+{
+	decode_cache* cache;
+	struct stat st;
+	void* file;
+	int fd = open(path, O_RDONLY);
+
+	if (fd < 0) {
+		return NULL;
+	}
+
+	if (fstat(fd, &st) < 0 || (size_t) st.st_size != sizeof(decode_header) + (size_t) mch->prg_rom_size * sizeof(decoded_op)) {
+		close(fd);
+		return NULL;
+	}
+
+	file = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (file == MAP_FAILED) {
+		return NULL;
+	}
+
+	cache = (decode_cache*) calloc(1, sizeof(decode_cache));
+	if (!cache) {
+		munmap(file, st.st_size);
+		return NULL;
+	}
+
+	cache->header = (decode_header*) file;
+	cache->ops = (decoded_op*) (cache->header + 1);
+	cache->mapped = st.st_size;
+
+	if (cache->header->magic != DECODE_MAGIC || cache->header->size != (uint32_t) mch->prg_rom_size || cache->header->rom_hash != rom_hash(mch)) {
+		decode_cache_destroy(cache);
+		return NULL;
+	}
+
+	return cache;
+}
+
+/* Returns 0 on success */
+int decode_cache_save(decode_cache* cache, FILE* fp)
+{
+	size_t count = cache->header->size;
+
+	if (fwrite(cache->header, sizeof(decode_header), 1, fp) != 1) {
+		return -1;
+	}
+	if (fwrite(cache->ops, sizeof(decoded_op), count, fp) != count) {
+		return -1;
+	}
+	return 0;
+}
+
+void decode_cache_destroy(decode_cache* cache)
+{
+	if (!cache) {
+		return;
+	}
+	if (cache->mapped) {
+		munmap(cache->header, cache->mapped);
+	} else {
+		free(cache->header);
+	}
+	free(cache);
+}
+
+/* Run mch from the cache, or from plain fetches again if cache is NULL */
+void decode_cache_attach(machine* mch, decode_cache* cache)
+{
+	mch->decoded = cache ? cache->ops : NULL;
+	map_pages(mch);
+}
@@ -0,0 +1,68 @@
+#ifndef DECODE_H
+#define DECODE_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include "machine.h"
+#include "codemap.h"
+
+#define DECODE_MAGIC 0x32434544 // "DEC2"
+#define DECODE_BANK_SIZE 0x4000 // prg banks are cached separately in 16KB pieces
+
+// superinstruction starting at a decoded_op, see fuse_ops
+#define FUSE_UNCHECKED 0 // not looked at yet, or waiting for the instructions after it
+#define FUSE_NONE 1
+#define FUSE_DEX_BNE 2
+#define FUSE_DEY_BNE 3
+#define FUSE_INX_CPX_BNE 4 // cpx immediate
+#define FUSE_CLC_ADC_IMM 5
+#define FUSE_CLC_ADC_ZP 6
+#define FUSE_SEC_SBC_IMM 7
+#define FUSE_SEC_SBC_ZP 8
+#define FUSE_LDA_IMM_STA_ABS 9
+#define FUSE_LDA_STA_ZP 10
+#define FUSE_LDA_STA_ABSX 11
+#define FUSE_LDA_STA_ABSY 12
+#define FUSE_LDA_STA_INDY 13
+#define FUSE_IDLE 14 // branch or jmp closing a loop that only reads memory
+
+/*
+* An instruction as execute_cpu sees it after the fetch. length 0 means the
+* byte has not been decoded yet. Instructions that cross a page are never
+* cached, so a cached operand always comes from the same rom page.
+*/
+typedef struct decoded_op {
+	uint8_t opcode;
+	uint8_t length;
+	uint8_t operand[2];
+	uint8_t fused; // FUSE_*
+	uint8_t reserved[3];
+} decoded_op;
+
+/*
+* File layout, so the whole file can be mapped and used in place: this
+* header, then one decoded_op per byte of prg rom, bank after bank.
+*/
+typedef struct decode_header {
+	uint32_t magic;
+	uint32_t size; // prg_rom_size of the rom
+	uint64_t rom_hash;
+	uint32_t bank_size;
+	uint32_t num_banks;
+	uint64_t reserved;
+} decode_header;
+
+typedef struct decode_cache {
+	decode_header* header;
+	decoded_op* ops;
+	size_t mapped; // length of the file mapping, 0 if the cache was built in memory
+} decode_cache;
+
+decode_cache* decode_cache_create(machine* mch, const code_map* map);
+decode_cache* decode_cache_open(machine* mch, const char* path);
+int decode_cache_save(decode_cache* cache, FILE* fp);
+void decode_cache_destroy(decode_cache* cache);
+void decode_cache_attach(machine* mch, decode_cache* cache);
+uint8_t fuse_ops(const decoded_op* op, int room);
+
+#endif
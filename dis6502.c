@@ -0,0 +1,143 @@
+/*
+* dis6502 - disassemble the PRG rom of an iNES file.
+*
+* usage: dis6502 rom.nes [bank]
+*
+* Prints every 16KB PRG bank, or just the one given, as a linear sweep:
+* "bank:address  bytes  instruction". The last bank is shown at 0xC000
+* where the fixed bank sits for most mappers, the others at 0x8000. The
+* rom is mapped rather than read, and lines are built straight into the
+* output buffer, so whole corpora can be piped through this.
+*/
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "disasm.h"
+
+#define HEADER_SIZE 16
+#define TRAINER_SIZE 512
+#define BANK_SIZE 0x4000
+#define OUT_SIZE 65536
+#define LINE_MAX 48 // "00:C000  A9 10 8D  " and the instruction, with room to spare
+
+static const char hex_digits[] = "0123456789ABCDEF";
+
+static char out[OUT_SIZE];
+static size_t out_len = 0;
+
+static char* put_hex(char* p, unsigned value, int digits)
+{
+	while (digits--) {
+		*p++ = hex_digits[(value >> (digits * 4)) & 0x0F];
+	}
+	return p;
+}
+
+static void dis_bank(const uint8_t* bank, int number, uint16_t origin)
+{
+	size_t offset = 0;
+
+	while (offset < BANK_SIZE) {
+		char* line;
+		char* p;
+		int length, i;
+
+		if (out_len + LINE_MAX > OUT_SIZE) {
+			fwrite(out, 1, out_len, stdout);
+			out_len = 0;
+		}
+
+		line = p = out + out_len;
+		p = put_hex(p, number, 2);
+		*p++ = ':';
+		p = put_hex(p, origin + offset, 4);
+		*p++ = ' ';
+		*p++ = ' ';
+
+		// the text goes after the byte column, which is filled in once the length is known
+		length = disassemble(bank + offset, BANK_SIZE - offset, origin + offset, p + 10);
+		for (i = 0; i < 3; i++) {
+			if (i < length) {
+				p = put_hex(p, bank[offset + i], 2);
+			} else {
+				*p++ = ' ';
+				*p++ = ' ';
+			}
+			*p++ = ' ';
+		}
+		*p++ = ' ';
+		p += strlen(p);
+		*p++ = '\n';
+
+		out_len += p - line;
+		offset += length;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	struct stat st;
+	const uint8_t* rom;
+	const uint8_t* prg;
+	int fd, banks, bank, first, last;
+
+	if (argc < 2 || argc > 3) {
+		fprintf(stderr, "usage: %s rom.nes [bank]\n", argv[0]);
+		return 1;
+	}
+
+	fd = open(argv[1], O_RDONLY);
+	if (fd < 0 || fstat(fd, &st) < 0) {
+		fprintf(stderr, "Could not open %s\n", argv[1]);
+		return 1;
+	}
+
+	if (st.st_size < HEADER_SIZE) {
+		fprintf(stderr, "%s is not an iNES file\n", argv[1]);
+		return 1;
+	}
+
+	rom = (const uint8_t*) mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (rom == MAP_FAILED) {
+		fprintf(stderr, "Could not map %s\n", argv[1]);
+		return 1;
+	}
+
+	if (memcmp(rom, "NES\x1A", 4) != 0) {
+		fprintf(stderr, "%s is not an iNES file\n", argv[1]);
+		return 1;
+	}
+
+	banks = rom[4];
+	prg = rom + HEADER_SIZE + ((rom[6] & 0x04) ? TRAINER_SIZE : 0);
+	if (prg + (size_t) banks * BANK_SIZE > rom + st.st_size) {
+		fprintf(stderr, "%s is truncated\n", argv[1]);
+		return 1;
+	}
+
+	first = 0;
+	last = banks - 1;
+	if (argc == 3) {
+		first = last = atoi(argv[2]);
+		if (first < 0 || first >= banks) {
+			fprintf(stderr, "bank %d out of range, the rom has %d\n", first, banks);
+			return 1;
+		}
+	}
+
+	madvise((void*) rom, st.st_size, MADV_SEQUENTIAL);
+
+	for (bank = first; bank <= last; bank++) {
+		dis_bank(prg + (size_t) bank * BANK_SIZE, bank, bank == banks - 1 ? 0xC000 : 0x8000);
+	}
+
+	fwrite(out, 1, out_len, stdout);
+	munmap((void*) rom, st.st_size);
+	return 0;
+}
@@ -0,0 +1,59 @@
+#include <stddef.h>
+#include <stdint.h>
+#include "optable.h"
+#include "disasm.h"
+
+static const char hex_digits[] = "0123456789ABCDEF";
+
+static char* put_str(char* p, const char* s)
+{
+	while (*s) {
+		*p++ = *s++;
+	}
+	return p;
+}
+
+// $ followed by digits hex digits
+static char* put_hex(char* p, uint16_t value, int digits)
+{
+	*p++ = '$';
+	while (digits--) {
+		*p++ = hex_digits[(value >> (digits * 4)) & 0x0F];
+	}
+	return p;
+}
+
+int disassemble(const uint8_t* bytes, size_t avail, uint16_t address, char* out)
+{
+	const opcode_info* info = &opcode_table[bytes[0]];
+	uint16_t operand;
+	char* p = out;
+
+	if (avail < info->length || info->mnemonic[0] == '?') {
+		p = put_hex(put_str(p, ".byte "), bytes[0], 2);
+		*p = '\0';
+		return 1;
+	}
+
+	operand = info->length == 3 ? bytes[1] | ((uint16_t) bytes[2] << 8) : bytes[1];
+	p = put_str(p, info->mnemonic);
+
+	switch (info->mode) {
+		case MODE_ACC: p = put_str(p, " A"); break;
+		case MODE_IMM: p = put_hex(put_str(p, " #"), operand, 2); break;
+		case MODE_ZP: p = put_hex(put_str(p, " "), operand, 2); break;
+		case MODE_ZPX: p = put_str(put_hex(put_str(p, " "), operand, 2), ",X"); break;
+		case MODE_ZPY: p = put_str(put_hex(put_str(p, " "), operand, 2), ",Y"); break;
+		case MODE_ABS: p = put_hex(put_str(p, " "), operand, 4); break;
+		case MODE_ABSX: p = put_str(put_hex(put_str(p, " "), operand, 4), ",X"); break;
+		case MODE_ABSY: p = put_str(put_hex(put_str(p, " "), operand, 4), ",Y"); break;
+		case MODE_IND: p = put_str(put_hex(put_str(p, " ("), operand, 4), ")"); break;
+		case MODE_INDX: p = put_str(put_hex(put_str(p, " ("), operand, 2), ",X)"); break;
+		case MODE_INDY: p = put_str(put_hex(put_str(p, " ("), operand, 2), "),Y"); break;
+		// print the target rather than the offset
+		case MODE_REL: p = put_hex(put_str(p, " "), address + 2 + (int8_t) operand, 4); break;
+	}
+
+	*p = '\0';
+	return info->length;
+}
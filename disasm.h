@@ -0,0 +1,18 @@
+#ifndef DISASM_H
+#define DISASM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define DISASM_MAX 12 // longest text disassemble() writes, "LDA ($12),Y" and the terminator
+
+/*
+* Write the instruction at bytes, which sits at address, as text into out.
+* out has to hold DISASM_MAX bytes; nothing is allocated, so this is safe to
+* call from the trace and from tight loops over a whole rom. Undocumented
+* opcodes and instructions cut off by the end of the buffer (avail bytes)
+* come out as ".byte $nn". Returns the number of bytes used, at least 1.
+*/
+int disassemble(const uint8_t* bytes, size_t avail, uint16_t address, char* out);
+
+#endif
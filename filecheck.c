@@ -0,0 +1,89 @@
+/*
+* make check: feed the file loaders headers that lie about their sizes,
+* and make sure each is turned away before anything is allocated from it.
+*/
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "codemap.h"
+#include "movie.h"
+
+static int failures = 0;
+
+static void expect(const char* what, int ok)
+{
+	if (!ok) {
+		fprintf(stdout, "%s: wrong\n", what);
+		failures++;
+	}
+}
+
+/* A temporary file holding header and then body bytes of body_size */
+static FILE* build(const void* header, size_t header_size, const void* body, size_t body_size)
+{
+	FILE* fp = tmpfile();
+
+	if (!fp || fwrite(header, 1, header_size, fp) != header_size || fwrite(body, 1, body_size, fp) != body_size) {
+		fprintf(stderr, "Could not write a temporary file.\n");
+		exit(2);
+	}
+	rewind(fp);
+	return fp;
+}
+
+/* Load a code map of size bytes claimed, with body bytes actually there */
+static code_map* load_map(uint32_t size, size_t body)
+{
+	static uint8_t kinds[0x8000];
+	code_map_header header = {CODEMAP_MAGIC, size, 0};
+	FILE* fp = build(&header, sizeof(header), kinds, body);
+	code_map* map = code_map_load(fp);
+
+	fclose(fp);
+	return map;
+}
+
+static void check_code_map(void)
+{
+	code_map* map = load_map(0x4000, 0x4000);
+
+	expect("code map, whole", map != NULL);
+	code_map_destroy(map);
+	expect("code map, size 0xFFFFFFFF", load_map(0xFFFFFFFF, 0x4000) == NULL);
+	expect("code map, size 0", load_map(0, 0) == NULL);
+	expect("code map, part of a bank", load_map(0x4001, 0x4001) == NULL);
+	expect("code map, truncated", load_map(0x8000, 0x4000) == NULL);
+}
+
+/* Load a movie of num_runs runs of one frame each claimed, with body runs there */
+static movie* load_movie(uint32_t num_frames, uint32_t num_runs, size_t body)
+{
+	static movie_run runs[4] = {{1, {0, 0}}, {1, {0, 0}}, {1, {0, 0}}, {1, {0, 0}}};
+	movie_header header = {MOVIE_MAGIC, num_frames, 0, 0, num_runs, 0};
+	FILE* fp = build(&header, sizeof(header), runs, body * sizeof(movie_run));
+	movie* mv = movie_load(fp);
+
+	fclose(fp);
+	return mv;
+}
+
+static void check_movie(void)
+{
+	movie* mv = load_movie(4, 4, 4);
+
+	expect("movie, whole", mv != NULL);
+	movie_destroy(mv);
+	expect("movie, 0xFFFFFFFF runs", load_movie(4, 0xFFFFFFFF, 4) == NULL);
+	expect("movie, 0xFFFFFFFF runs and frames", load_movie(0xFFFFFFFF, 0xFFFFFFFF, 4) == NULL);
+	expect("movie, runs short of the frames", load_movie(5, 4, 4) == NULL);
+}
+
+int main(void)
+{
+	check_code_map();
+	check_movie();
+
+	fprintf(stdout, "files: %s\n", failures ? "bad headers got through" : "bad headers rejected");
+	return failures ? 1 : 0;
+}
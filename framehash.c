@@ -0,0 +1,210 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "graphics.h"
+#include "hash.h"
+#include "framehash.h"
+
+#define GRID_W 9 // columns of the perceptual grid, one more than the bits per row
+#define GRID_H 8
+
+static uint64_t rotl(uint64_t x, int r)
+{
+	return (x << r) | (x >> (64 - r));
+}
+
+/*
+* A frame is 240KB, so this mixes eight bytes at a time instead of going
+* byte by byte like hash_bytes.
+*/
+uint64_t frame_exact_hash(const uint32_t* pixels)
+{
+	uint64_t hash = HASH_SEED;
+	size_t i;
+
+	for (i = 0; i < PPU_WIDTH * PPU_HEIGHT; i += 2) {
+		uint64_t word;
+		memcpy(&word, &pixels[i], sizeof(word));
+		hash ^= word * 0x9E3779B97F4A7C15ULL;
+		hash = rotl(hash, 27) * 0xC2B2AE3D27D4EB4FULL;
+	}
+
+	hash ^= hash >> 33;
+	hash *= 0xFF51AFD7ED558CCDULL;
+	return hash ^ (hash >> 33);
+}
+
+/*
+* Sum the brightness of the frame into a 9x8 grid and set a bit for every
+* cell brighter than the one to its right.
+*/
+uint64_t frame_perceptual_hash(const uint32_t* pixels)
+{
+	uint32_t grid[GRID_H][GRID_W];
+	uint8_t column[PPU_WIDTH];
+	uint64_t hash = 0;
+	int x, y;
+
+	memset(grid, 0, sizeof(grid));
+	for (x = 0; x < PPU_WIDTH; x++) {
+		column[x] = x * GRID_W / PPU_WIDTH;
+	}
+
+	for (y = 0; y < PPU_HEIGHT; y++) {
+		uint32_t* row = grid[y * GRID_H / PPU_HEIGHT];
+		const uint32_t* p = &pixels[y * PPU_WIDTH];
+		for (x = 0; x < PPU_WIDTH; x++) {
+			// rec. 601 luma, red at the lowest address
+			row[column[x]] += (77 * (p[x] & 0xFF) + 150 * ((p[x] >> 8) & 0xFF) + 29 * ((p[x] >> 16) & 0xFF)) >> 8;
+		}
+	}
+
+	// the columns are not all the same width, so compare averages
+	for (y = 0; y < GRID_H; y++) {
+		for (x = 0; x < GRID_W - 1; x++) {
+			uint32_t width = (x + 1) * PPU_WIDTH / GRID_W - x * PPU_WIDTH / GRID_W;
+			uint32_t next = (x + 2) * PPU_WIDTH / GRID_W - (x + 1) * PPU_WIDTH / GRID_W;
+			hash = (hash << 1) | ((uint64_t) grid[y][x] * next > (uint64_t) grid[y][x + 1] * width);
+		}
+	}
+
+	return hash;
+}
+
+/* Bits that differ between two perceptual hashes */
+int hash_distance(uint64_t a, uint64_t b)
+{
+	return __builtin_popcountll(a ^ b);
+}
+
+hash_trace* hash_trace_create(void)
+{
+	hash_trace* trace = (hash_trace*) calloc(1, sizeof(hash_trace));
+
+	if (trace) {
+		trace->header.magic = TRACE_MAGIC;
+	}
+	return trace;
+}
+
+void hash_trace_destroy(hash_trace* trace)
+{
+	if (trace) {
+		free(trace->frames);
+		free(trace);
+	}
+}
+
+/* The frame_sink, hashing each frame into the trace */
+void hash_trace_frame(void* ctx, const uint32_t* pixels, int64_t frame)
+{
+	hash_trace* trace = (hash_trace*) ctx;
+	frame_hash* at;
+
+	(void) frame;
+	if (trace->failed) {
+		return;
+	}
+
+	if (trace->header.num_frames == trace->max_frames) {
+		uint64_t max_frames = trace->max_frames ? trace->max_frames * 2 : 1024;
+		frame_hash* frames = (frame_hash*) realloc(trace->frames, max_frames * sizeof(frame_hash));
+		if (!frames) {
+			trace->failed = 1;
+			return;
+		}
+		trace->frames = frames;
+		trace->max_frames = max_frames;
+	}
+
+	at = &trace->frames[trace->header.num_frames++];
+	at->exact = frame_exact_hash(pixels);
+	at->perceptual = frame_perceptual_hash(pixels);
+}
+
+/* One hash for the whole run, of every exact frame hash in order */
+uint64_t hash_trace_digest(const hash_trace* trace)
+{
+	uint64_t hash = HASH_SEED;
+	uint64_t i;
+
+	for (i = 0; i < trace->header.num_frames; i++) {
+		hash = hash_bytes(&trace->frames[i].exact, sizeof(uint64_t), hash);
+	}
+	return hash;
+}
+
+/* Returns 0 on success */
+int hash_trace_save(const hash_trace* trace, FILE* fp)
+{
+	size_t count = trace->header.num_frames;
+
+	if (fwrite(&trace->header, sizeof(trace_header), 1, fp) != 1) {
+		return -1;
+	}
+	if (fwrite(trace->frames, sizeof(frame_hash), count, fp) != count) {
+		return -1;
+	}
+	return 0;
+}
+
+/* Returns NULL if the file is not a trace, is truncated, or out of memory */
+hash_trace* hash_trace_load(FILE* fp)
+{
+	hash_trace* trace = (hash_trace*) calloc(1, sizeof(hash_trace));
+
+	if (!trace) {
+		return NULL;
+	}
+
+	if (fread(&trace->header, sizeof(trace_header), 1, fp) != 1 || trace->header.magic != TRACE_MAGIC) {
+		free(trace);
+		return NULL;
+	}
+
+	// a count the multiply below would wrap
+	if (trace->header.num_frames > SIZE_MAX / sizeof(frame_hash) - 1) {
+		free(trace);
+		return NULL;
+	}
+
+	trace->max_frames = trace->header.num_frames;
+	trace->frames = (frame_hash*) malloc(trace->max_frames * sizeof(frame_hash) + 1);
+	if (!trace->frames || fread(trace->frames, sizeof(frame_hash), trace->max_frames, fp) != trace->max_frames) {
+		hash_trace_destroy(trace);
+		return NULL;
+	}
+
+	return trace;
+}
+
+/* Compare a run frame by frame with a golden trace of the same rom and input */
+void hash_trace_compare(const hash_trace* run, const hash_trace* golden, trace_diff* diff)
+{
+	uint64_t n = run->header.num_frames, m = golden->header.num_frames;
+	uint64_t i;
+
+	diff->exact = 0;
+	diff->visible = 0;
+	diff->first = -1;
+
+	for (i = 0; i < n || i < m; i++) {
+		char visible = 1;
+
+		if (i < n && i < m) {
+			if (run->frames[i].exact == golden->frames[i].exact) {
+				continue;
+			}
+			visible = hash_distance(run->frames[i].perceptual, golden->frames[i].perceptual) > VISIBLE_DISTANCE;
+		}
+
+		diff->exact++;
+		if (visible) {
+			diff->visible++;
+			if (diff->first < 0) {
+				diff->first = i;
+			}
+		}
+	}
+}
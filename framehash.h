@@ -0,0 +1,53 @@
+#ifndef FRAMEHASH_H
+#define FRAMEHASH_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+#define TRACE_MAGIC 0x31544846 // "FHT1"
+#define VISIBLE_DISTANCE 4 // perceptual bits that may differ before a frame looks different
+
+/*
+* Two hashes per frame: exact changes with any pixel, perceptual is a
+* difference hash of a 9x8 grid of average brightness, so frames that
+* look alike have hashes a few bits apart (see hash_distance).
+*/
+typedef struct frame_hash {
+	uint64_t exact;
+	uint64_t perceptual;
+} frame_hash;
+
+// file header, followed by num_frames frame_hashes
+typedef struct trace_header {
+	uint32_t magic;
+	uint32_t reserved;
+	uint64_t num_frames;
+} trace_header;
+
+typedef struct hash_trace {
+	trace_header header;
+	frame_hash* frames;
+	uint64_t max_frames;
+	char failed; // out of memory, frames after it are missing
+} hash_trace;
+
+// how a run compares with a golden trace
+typedef struct trace_diff {
+	uint64_t exact; // frames with any pixel different
+	uint64_t visible; // frames more than VISIBLE_DISTANCE apart, or missing from either
+	int64_t first; // first visibly different frame, -1 if none
+} trace_diff;
+
+uint64_t frame_exact_hash(const uint32_t* pixels);
+uint64_t frame_perceptual_hash(const uint32_t* pixels);
+int hash_distance(uint64_t a, uint64_t b);
+
+hash_trace* hash_trace_create(void);
+void hash_trace_destroy(hash_trace* trace);
+void hash_trace_frame(void* ctx, const uint32_t* pixels, int64_t frame);
+uint64_t hash_trace_digest(const hash_trace* trace);
+int hash_trace_save(const hash_trace* trace, FILE* fp);
+hash_trace* hash_trace_load(FILE* fp);
+void hash_trace_compare(const hash_trace* run, const hash_trace* golden, trace_diff* diff);
+
+#endif
@@ -1,12 +1,551 @@
 #include <stdio.h>
 #include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "machine.h"
+#include "graphics.h"
 
-void emulate_graphics(uint8_t* memory)
+#define LINE_DOTS 341
+#define FRAME_LINES 262 // 240 drawn, vblank, and the pre-render line
+#define RENDERING(r) ((r)->mask & 0x18) // background or sprites on
+
+// 2C02 colours as rgba in memory order
+#define RGB(c) (0xFF000000u | (((c) & 0xFF) << 16) | ((c) & 0xFF00) | (((c) >> 16) & 0xFF))
+static const uint32_t colours[64] = {
+	RGB(0x666666), RGB(0x002A88), RGB(0x1412A7), RGB(0x3B00A4), RGB(0x5C007E), RGB(0x6E0040), RGB(0x6C0600), RGB(0x561D00),
+	RGB(0x333500), RGB(0x0B4800), RGB(0x005200), RGB(0x004F08), RGB(0x00404D), RGB(0x000000), RGB(0x000000), RGB(0x000000),
+	RGB(0xADADAD), RGB(0x155FD9), RGB(0x4240FF), RGB(0x7527FE), RGB(0xA01ACC), RGB(0xB71E7B), RGB(0xB53120), RGB(0x994E00),
+	RGB(0x6B6D00), RGB(0x388700), RGB(0x0C9300), RGB(0x008F32), RGB(0x007C8D), RGB(0x000000), RGB(0x000000), RGB(0x000000),
+	RGB(0xFFFEFF), RGB(0x64B0FF), RGB(0x9290FF), RGB(0xC676FF), RGB(0xF36AFF), RGB(0xFE6ECC), RGB(0xFE8170), RGB(0xEA9E22),
+	RGB(0xBCBE00), RGB(0x88D800), RGB(0x5CE430), RGB(0x45E082), RGB(0x48CDDE), RGB(0x4F4F4F), RGB(0x000000), RGB(0x000000),
+	RGB(0xFFFEFF), RGB(0xC0DFFF), RGB(0xD3D2FF), RGB(0xE8C8FF), RGB(0xFBC2FF), RGB(0xFEC4EA), RGB(0xFECCC5), RGB(0xF7D8A5),
+	RGB(0xE4E594), RGB(0xCFEF96), RGB(0xBDF4AB), RGB(0xB3F3CC), RGB(0xB5EBF2), RGB(0xB8B8B8), RGB(0x000000), RGB(0x000000),
+};
+
+static uint64_t spread[256]; // a pattern byte as a row of 0/1 bytes
+static pthread_once_t spread_once = PTHREAD_ONCE_INIT;
+
+static void spread_init(void)
+{
+	int i, bit;
+
+	for (i = 0; i < 256; i++) {
+		uint8_t row[8];
+		for (bit = 0; bit < 8; bit++) {
+			row[bit] = (i >> (7 - bit)) & 1;
+		}
+		memcpy(&spread[i], row, 8);
+	}
+}
+
+/*
+* Decode the row of chr at address, either bit plane, into patterns. Done
+* for all of chr up front and again for each byte of chr ram written, so
+* drawing a tile is a lookup.
+*/
+static void decode_row(renderer* r, uint16_t address)
+{
+	const uint8_t* low = &r->chr[address & ~0x08];
+
+	r->patterns[address >> 4][address & 0x07] = spread[low[0]] | (spread[low[8]] << 1);
+}
+
+/* Offset into the 2KB of nametable ram behind a ppu address */
+static uint16_t nametable_offset(renderer* r, uint16_t address)
+{
+	if (r->vertical) {
+		return address & 0x07FF;
+	}
+	return ((address >> 1) & 0x0400) | (address & 0x03FF);
+}
+
+/* Palette entry behind a ppu address, 0x3F10/14/18/1C are 0x3F00/04/08/0C */
+static uint8_t palette_offset(uint16_t address)
+{
+	address &= 0x1F;
+	return (address & 0x13) == 0x10 ? address & 0x0F : address;
+}
+
+static void vram_write(renderer* r, uint8_t value)
+{
+	uint16_t address = r->v & 0x3FFF;
+
+	if (address < 0x2000) {
+		if (r->chr == r->chr_ram) {
+			r->chr_ram[address] = value;
+			decode_row(r, address);
+		}
+	} else if (address < 0x3F00) {
+		r->nametables[nametable_offset(r, address)] = value;
+	} else {
+		r->palette[palette_offset(address)] = value & 0x3F;
+	}
+}
+
+/* Only a new y moves a sprite to other lines */
+static void set_oam(renderer* r, uint8_t address, uint8_t value)
+{
+	if ((address & 0x03) == 0 && r->oam[address] != value) {
+		r->sprites_dirty = 1;
+	}
+	r->oam[address] = value;
+}
+
+/* All of oam at once, from a dma slot */
+static void copy_oam(renderer* r, const uint8_t* oam)
+{
+	int i;
+
+	for (i = 0; i < 256 && !r->sprites_dirty; i += 4) {
+		if (r->oam[i] != oam[i]) {
+			r->sprites_dirty = 1;
+		}
+	}
+	memcpy(r->oam, oam, 256);
+}
+
+/* The register writes, as the 2C02 applies them to v, t and the toggle */
+static void apply(renderer* r, const ppu_event* e)
+{
+	uint8_t value = e->value;
+
+	switch (e->kind) {
+		case PPU_OAM:
+			copy_oam(r, r->dma[e->reg]);
+			return;
+		case PPU_READ:
+			if (e->reg == 2) {
+				r->latch = 0;
+			} else {
+				r->v += (r->ctrl & 0x04) ? 32 : 1;
+			}
+			return;
+		case PPU_SYNC:
+			return;
+		case PPU_RESET:
+			r->ctrl = 0;
+			r->mask = 0;
+			r->oam_addr = 0;
+			r->latch = 0;
+			r->fine_x = 0;
+			r->v = 0;
+			r->t = 0;
+			r->sprites_dirty = 1;
+			r->origin = e->cycle;
+			r->frame = 0;
+			r->line = 0;
+			return;
+	}
+
+	switch (e->reg) {
+		case 0:
+			if ((r->ctrl ^ value) & 0x20) {
+				r->sprites_dirty = 1;
+			}
+			r->ctrl = value;
+			r->t = (r->t & 0xF3FF) | ((uint16_t) (value & 0x03) << 10);
+			break;
+		case 1:
+			r->mask = value;
+			break;
+		case 3:
+			r->oam_addr = value;
+			break;
+		case 4:
+			set_oam(r, r->oam_addr++, value);
+			break;
+		case 5:
+			if (!r->latch) {
+				r->fine_x = value & 0x07;
+				r->t = (r->t & 0xFFE0) | (value >> 3);
+			} else {
+				r->t = (r->t & 0x8C1F) | ((uint16_t) (value & 0x07) << 12) | ((uint16_t) (value & 0xF8) << 2);
+			}
+			r->latch ^= 1;
+			break;
+		case 6:
+			if (!r->latch) {
+				r->t = (r->t & 0x00FF) | ((uint16_t) (value & 0x3F) << 8);
+			} else {
+				r->t = (r->t & 0xFF00) | value;
+				r->v = r->t;
+			}
+			r->latch ^= 1;
+			break;
+		case 7:
+			vram_write(r, value);
+			r->v += (r->ctrl & 0x04) ? 32 : 1;
+			break;
+	}
+}
+
+/* Palette indexes of the background on the line v points at, 0 for clear */
+static void draw_background(renderer* r, uint8_t* out)
+{
+	uint8_t line[PPU_WIDTH + 16];
+	uint16_t v = r->v;
+	uint16_t table = (r->ctrl & 0x10) ? 0x1000 : 0;
+	uint16_t fine_y = (v >> 12) & 0x07;
+	int tile;
+
+	for (tile = 0; tile < 33; tile++) {
+		uint16_t coarse_x = v & 0x1F, coarse_y = (v >> 5) & 0x1F;
+		uint8_t name = r->nametables[nametable_offset(r, 0x2000 | (v & 0x0FFF))];
+		uint8_t attr = r->nametables[nametable_offset(r, 0x23C0 | (v & 0x0C00) | ((coarse_y >> 2) << 3) | (coarse_x >> 2))];
+		uint8_t palette = ((attr >> (((coarse_y & 2) << 1) | (coarse_x & 2))) & 0x03) << 2;
+		uint64_t row = r->patterns[(table >> 4) + name][fine_y];
+
+		// the palette goes on every byte that is not clear
+		row |= ((row | (row >> 1)) & 0x0101010101010101ULL) * palette;
+		memcpy(&line[tile * 8], &row, 8);
+
+		// next tile, into the next nametable across after 32
+		if (coarse_x == 31) {
+			v = (v & ~0x001F) ^ 0x0400;
+		} else {
+			v++;
+		}
+	}
+
+	memcpy(out, line + r->fine_x, PPU_WIDTH);
+}
+
+/*
+* Sort the sprites into the lines they cover, once per change of oam
+* instead of a pass over all 64 for every line. Lower numbers come first
+* and only the first eight on a line make its list; the count goes on, so
+* a count over 8 is the line's sprite overflow.
+*/
+static void evaluate_sprites(renderer* r)
+{
+	int height = (r->ctrl & 0x20) ? 16 : 8;
+	int i, y;
+
+	memset(r->line_count, 0, sizeof(r->line_count));
+
+	for (i = 0; i < 64; i++) {
+		int top = r->oam[i * 4] + 1; // oam holds the line above the top
+		for (y = top; y < top + height && y < PPU_HEIGHT; y++) {
+			if (r->line_count[y] < 8) {
+				r->line_sprites[y][r->line_count[y]] = i;
+			}
+			r->line_count[y]++;
+		}
+	}
+
+	r->sprites_dirty = 0;
+}
+
+/*
+* Palette indexes of the sprites on scanline y, 0 for clear, with bit 7
+* set for sprites behind the background. Only the first eight sprites on
+* the line are drawn, lower numbers in front.
+*/
+static void draw_sprites(renderer* r, int y, uint8_t* out)
+{
+	int height = (r->ctrl & 0x20) ? 16 : 8;
+	int count = r->line_count[y] < 8 ? r->line_count[y] : 8;
+	int i, x;
+
+	memset(out, 0, PPU_WIDTH);
+
+	for (i = 0; i < count; i++) {
+		const uint8_t* sprite = &r->oam[r->line_sprites[y][i] * 4];
+		int row = y - (sprite[0] + 1);
+		uint8_t tile = sprite[1], attr = sprite[2];
+		uint16_t address;
+		uint64_t pattern;
+
+		if (attr & 0x80) {
+			row = height - 1 - row;
+		}
+		if (height == 16) {
+			address = ((tile & 1) ? 0x1000 : 0) + (tile & 0xFE) * 16 + (row >= 8 ? 16 : 0) + (row & 7);
+		} else {
+			address = ((r->ctrl & 0x08) ? 0x1000 : 0) + tile * 16 + row;
+		}
+		pattern = r->patterns[address >> 4][address & 0x07];
+		if (attr & 0x40) {
+			pattern = __builtin_bswap64(pattern);
+		}
+
+		for (x = 0; x < 8 && sprite[3] + x < PPU_WIDTH; x++, pattern >>= 8) {
+			uint8_t pixel = pattern & 0x03;
+			uint8_t* at = &out[sprite[3] + x];
+			if (pixel && !*at) {
+				*at = (attr & 0x20 ? 0x80 : 0) | 0x10 | ((attr & 0x03) << 2) | pixel;
+			}
+		}
+	}
+}
+
+/* Draw scanline y of the frame with the ppu as it is now */
+static void draw_line(renderer* r, int y)
 {
-	int i = 0;
-	for (i = 0x00002000; i <= 0x00003FFF; i++) {
-		if (memory[i]) {
-			fprintf(stdout,"Address %x on PPU\n", memory[i]);
+	uint8_t background[PPU_WIDTH], sprites[PPU_WIDTH];
+	uint32_t* out = &r->pixels[y * PPU_WIDTH];
+	uint8_t grey = (r->mask & 0x01) ? 0x30 : 0x3F;
+	int x;
+
+	if (!RENDERING(r)) {
+		// the backdrop, or the colour v points at inside the palette
+		uint8_t colour = r->palette[(r->v & 0x3F00) == 0x3F00 ? palette_offset(r->v) : 0];
+		for (x = 0; x < PPU_WIDTH; x++) {
+			out[x] = colours[colour & grey];
 		}
+		return;
+	}
+
+	// the horizontal half of t goes into v at the start of every line
+	r->v = (r->v & ~0x041F) | (r->t & 0x041F);
+
+	memset(background, 0, sizeof(background));
+	if (r->mask & 0x08) {
+		draw_background(r, background);
+		if (!(r->mask & 0x02)) {
+			memset(background, 0, 8);
+		}
+	}
+
+	memset(sprites, 0, sizeof(sprites));
+	if (r->mask & 0x10) {
+		if (r->sprites_dirty) {
+			evaluate_sprites(r);
+		}
+		draw_sprites(r, y, sprites);
+		if (!(r->mask & 0x04)) {
+			memset(sprites, 0, 8);
+		}
+	}
+
+	for (x = 0; x < PPU_WIDTH; x++) {
+		uint8_t sprite = sprites[x] & 0x7F;
+		uint8_t index = background[x];
+		if (sprite && (!index || !(sprites[x] & 0x80))) {
+			index = sprite;
+		}
+		out[x] = colours[r->palette[index] & grey];
+	}
+
+	// then down a line, wrapping at the bottom of the nametable
+	if ((r->v & 0x7000) != 0x7000) {
+		r->v += 0x1000;
+	} else {
+		uint16_t coarse_y = (r->v >> 5) & 0x1F;
+		r->v &= ~0x7000;
+		if (coarse_y == 29) {
+			coarse_y = 0;
+			r->v ^= 0x0800;
+		} else if (coarse_y == 31) {
+			coarse_y = 0;
+		} else {
+			coarse_y++;
+		}
+		r->v = (r->v & ~0x03E0) | (coarse_y << 5);
+	}
+}
+
+/*
+* Draw every scanline that starts before cycle. Writes land between
+* scanlines, so a split made by writing the scroll mid frame shows up on
+* the right line. A frame is finished when its last visible line is.
+*/
+static void advance(renderer* r, int64_t cycle)
+{
+	int64_t dot = (cycle - r->origin) * 3;
+
+	while (r->frame * FRAME_DOTS + (int64_t) r->line * LINE_DOTS < dot) {
+		if (r->line == 0 && RENDERING(r)) {
+			// the vertical half of t goes into v on the pre-render line
+			r->v = (r->v & ~0x7BE0) | (r->t & 0x7BE0);
+		}
+		if (r->line < PPU_HEIGHT) {
+			draw_line(r, r->line);
+		}
+		if (++r->line == PPU_HEIGHT) {
+			int i;
+			for (i = 0; i < r->num_sinks; i++) {
+				r->sinks[i](r->sink_ctx[i], r->pixels, r->frames);
+			}
+			r->frames++;
+		} else if (r->line == FRAME_LINES) {
+			r->line = 0;
+			r->frame++;
+		}
+	}
+}
+
+/* Draw from every event queued so far, on whichever thread draws */
+void render_drain(renderer* r)
+{
+	ppu_queue* q = &r->queue;
+	uint32_t tail = atomic_load_explicit(&q->tail, memory_order_relaxed);
+	uint32_t head = atomic_load_explicit(&q->head, memory_order_acquire);
+
+	for (; tail != head; tail++) {
+		const ppu_event* e = &q->events[tail & (PPU_QUEUE_SIZE - 1)];
+		advance(r, e->cycle);
+		apply(r, e);
+	}
+
+	atomic_store_explicit(&q->tail, tail, memory_order_release);
+}
+
+/* The drawing thread, sleeps a little whenever the cpu is behind */
+static void* render_thread(void* arg)
+{
+	renderer* r = (renderer*) arg;
+	struct timespec nap = {0, 100000};
+	ppu_queue* q = &r->queue;
+
+	for (;;) {
+		char stop = atomic_load_explicit(&r->stop, memory_order_acquire);
+		if (atomic_load_explicit(&q->head, memory_order_acquire) != atomic_load_explicit(&q->tail, memory_order_relaxed)) {
+			render_drain(r);
+		} else if (stop) {
+			return NULL;
+		} else {
+			nanosleep(&nap, NULL);
+		}
+	}
+}
+
+/*
+* Start drawing the frames of mch, from its current cycle on. threaded
+* draws on a thread of its own. Returns NULL if out of memory or the thread
+* could not be started.
+*/
+renderer* render_create(machine* mch, char threaded)
+{
+	renderer* r = (renderer*) aligned_alloc(64, sizeof(renderer));
+	int i, row;
+
+	if (!r) {
+		return NULL;
+	}
+	memset(r, 0, sizeof(renderer));
+
+	r->threaded = threaded;
+	r->vertical = mch->mirroring == MIRROR_VERTICAL;
+	r->chr = mch->chr_rom_size >= 0x2000 ? mch->chr_rom : r->chr_ram;
+	r->origin = mch->cpu.cycle;
+	r->sprites_dirty = 1;
+	pthread_once(&spread_once, spread_init);
+	for (i = 0; i < 0x2000; i += 16) {
+		for (row = 0; row < 8; row++) {
+			decode_row(r, i + row);
+		}
+	}
+
+	if (threaded && pthread_create(&r->thread, NULL, render_thread, r) != 0) {
+		free(r);
+		return NULL;
+	}
+
+	mch->render = r;
+	return r;
+}
+
+/*
+* Hand every frame finished from now on to sink. Has to be called before
+* the cpu runs with a threaded renderer. Returns 0, or -1 if there are
+* RENDER_SINKS already.
+*/
+int render_add_sink(renderer* r, frame_sink sink, void* ctx)
+{
+	if (r->num_sinks == RENDER_SINKS) {
+		return -1;
+	}
+	r->sinks[r->num_sinks] = sink;
+	r->sink_ctx[r->num_sinks] = ctx;
+	r->num_sinks++;
+	return 0;
+}
+
+/*
+* Finish drawing everything queued and stop the thread, if any. Anything
+* queued after this is drawn on the cpu thread.
+*/
+void render_finish(renderer* r)
+{
+	if (r->threaded) {
+		atomic_store_explicit(&r->stop, 1, memory_order_release);
+		pthread_join(r->thread, NULL);
+		r->threaded = 0;
+	}
+	render_drain(r);
+}
+
+void render_destroy(renderer* r)
+{
+	if (r) {
+		render_finish(r);
+		free(r);
+	}
+}
+
+/*
+* The cpu got to cycle, so every line before it can be drawn. Drawn here
+* when not threaded, otherwise this only wakes the renderer up.
+*/
+void render_sync(renderer* r, int64_t cycle)
+{
+	render_push(r, cycle, PPU_SYNC, 0, 0);
+	if (!r->threaded) {
+		render_drain(r);
+	}
+}
+
+/*
+* The machine was reset and its clock starts again at cycle. The frame
+* being drawn is dropped and the next one starts at cycle, from a ppu with
+* its registers cleared. Everything before the reset has to be synced
+* already.
+*/
+void render_reset(renderer* r, int64_t cycle)
+{
+	r->queue.latch = 0;
+	render_push(r, cycle, PPU_RESET, 0, 0);
+	if (!r->threaded) {
+		render_drain(r);
+	}
+}
+
+/* Wait for the renderer to apply the event at queue index, drawing here if not threaded */
+static void wait_applied(renderer* r, uint32_t index)
+{
+	ppu_queue* q = &r->queue;
+	uint32_t head = atomic_load_explicit(&q->head, memory_order_relaxed);
+
+	// still queued while it is between tail and head
+	if (head - index - 1 < head - q->tail_seen) {
+		q->tail_seen = atomic_load_explicit(&q->tail, memory_order_acquire);
+		while (head - index - 1 < head - q->tail_seen) {
+			if (r->threaded) {
+				sched_yield();
+			} else {
+				render_drain(r);
+			}
+			q->tail_seen = atomic_load_explicit(&q->tail, memory_order_acquire);
+		}
+	}
+}
+
+/*
+* Oam after a dma. The renderer cannot see cpu memory, so the image is
+* copied into the next dma slot and goes with a single event. A slot is
+* only written over once the renderer has applied the dma it last held.
+*/
+void render_oam(renderer* r, int64_t cycle, const uint8_t* oam)
+{
+	int slot = r->dmas % PPU_DMA_SLOTS;
+
+	if (r->dmas >= PPU_DMA_SLOTS) {
+		wait_applied(r, r->dma_event[slot]);
 	}
-}
\ No newline at end of file
+	memcpy(r->dma[slot], oam, 256);
+	r->dma_event[slot] = atomic_load_explicit(&r->queue.head, memory_order_relaxed);
+	r->dmas++;
+	render_push(r, cycle, PPU_OAM, (uint8_t) slot, 0);
+}
@@ -1,6 +1,162 @@
 #ifndef GRAPHICS_H
 #define GRAPHICS_H
 
-void emulate_graphics(uint8_t* memory);
+#include <stdint.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <sched.h>
+#include "machine.h"
 
-#endif
\ No newline at end of file
+#define PPU_WIDTH 256
+#define PPU_HEIGHT 240
+#define PPU_QUEUE_SIZE 8192 // events in flight between the cpu and the renderer, a power of two
+#define RENDER_SINKS 4 // consumers of finished frames
+#define CHR_TILES 512 // 16 byte tiles in the two pattern tables
+#define PPU_DMA_SLOTS 8 // oam dmas in flight between the cpu and the renderer
+
+// what the cpu did to the ppu
+#define PPU_WRITE 0 // value written to register reg, 0x2000 + reg
+#define PPU_READ 1 // register reg read, only for the reads that change ppu state
+#define PPU_OAM 2 // oam replaced by a dma, the image is in dma slot reg
+#define PPU_SYNC 3 // nothing, the cpu got to cycle
+#define PPU_RESET 4 // the machine was reset, frame 0 starts again at cycle
+
+/*
+* Called on the drawing thread with every finished frame, numbered from 0.
+* pixels only stay valid until the call returns.
+*/
+typedef void (*frame_sink)(void* ctx, const uint32_t* pixels, int64_t frame);
+
+typedef struct ppu_event {
+	int64_t cycle;
+	uint8_t kind;
+	uint8_t reg;
+	uint8_t value;
+} ppu_event;
+
+/*
+* Single producer, single consumer ring of events. The cpu only stores
+* head and the renderer only stores tail, each on its own cache line.
+*/
+typedef struct ppu_queue {
+	_Atomic uint32_t head;
+	uint32_t tail_seen; // the cpu's last look at tail, so a push rarely reads the renderer's line
+	uint8_t latch; // the cpu's copy of the 0x2005/0x2006 write toggle
+	char pad1[55];
+	_Atomic uint32_t tail;
+	char pad2[60];
+	ppu_event events[PPU_QUEUE_SIZE];
+} ppu_queue;
+
+/*
+* Draws frames from the register writes the cpu makes, either on the cpu
+* thread as the queue fills up or pipelined on a thread of its own, which
+* draws frame N while the cpu runs frame N + 1. Everything below the queue
+* belongs to whichever thread draws, rebuilt from the events alone, so
+* the cpu never waits on a lock.
+*/
+typedef struct renderer {
+	ppu_queue queue;
+	char threaded;
+	pthread_t thread;
+	_Atomic char stop;
+
+	// oam images of the last dmas, written by the cpu and copied in by the renderer, see render_oam
+	uint8_t dma[PPU_DMA_SLOTS][256];
+	uint32_t dma_event[PPU_DMA_SLOTS]; // queue index of the event each slot went with
+	int64_t dmas; // dmas so far, the next goes in slot dmas % PPU_DMA_SLOTS
+
+	// the ppu as rebuilt from the events
+	uint8_t ctrl; // 0x2000
+	uint8_t mask; // 0x2001
+	uint8_t oam_addr;
+	uint8_t latch; // 0x2005/0x2006 write toggle
+	uint8_t fine_x;
+	uint16_t v; // current vram address
+	uint16_t t; // temporary vram address, the top left of the screen
+	uint8_t vertical; // nametable mirroring
+	uint8_t palette[32];
+	uint8_t oam[256];
+	uint8_t line_sprites[PPU_HEIGHT][8]; // the first eight sprites on each line, see evaluate_sprites
+	uint8_t line_count[PPU_HEIGHT]; // sprites on each line, more than 8 is an overflow
+	uint8_t sprites_dirty; // a y or the sprite size changed since the lists were built
+	uint8_t nametables[0x800];
+	uint8_t chr_ram[0x2000];
+	const uint8_t* chr; // pattern tables, chr rom or chr_ram
+	uint64_t patterns[CHR_TILES][8]; // chr decoded a row at a time, a byte per pixel from the left
+
+	int64_t origin; // cycle frame 0 started on
+	int64_t frame; // frame being drawn
+	int line; // next scanline of it, 0-261
+	int64_t frames; // frames finished
+	frame_sink sinks[RENDER_SINKS];
+	void* sink_ctx[RENDER_SINKS];
+	int num_sinks;
+	uint32_t pixels[PPU_WIDTH * PPU_HEIGHT]; // rgba, the frame being drawn
+} renderer;
+
+renderer* render_create(machine* mch, char threaded);
+void render_finish(renderer* r);
+void render_destroy(renderer* r);
+void render_sync(renderer* r, int64_t cycle);
+void render_reset(renderer* r, int64_t cycle);
+void render_drain(renderer* r);
+void render_oam(renderer* r, int64_t cycle, const uint8_t* oam);
+int render_add_sink(renderer* r, frame_sink sink, void* ctx);
+
+/* Queue an event, drawing on this thread or waiting for the renderer if full */
+static inline void render_push(renderer* r, int64_t cycle, uint8_t kind, uint8_t reg, uint8_t value)
+{
+	ppu_queue* q = &r->queue;
+	uint32_t head = atomic_load_explicit(&q->head, memory_order_relaxed);
+	ppu_event* e;
+
+	if (head - q->tail_seen == PPU_QUEUE_SIZE) {
+		q->tail_seen = atomic_load_explicit(&q->tail, memory_order_acquire);
+		while (head - q->tail_seen == PPU_QUEUE_SIZE) {
+			if (r->threaded) {
+				sched_yield();
+			} else {
+				render_drain(r);
+			}
+			q->tail_seen = atomic_load_explicit(&q->tail, memory_order_acquire);
+		}
+	}
+
+	e = &q->events[head & (PPU_QUEUE_SIZE - 1)];
+	e->cycle = cycle;
+	e->kind = kind;
+	e->reg = reg;
+	e->value = value;
+	atomic_store_explicit(&q->head, head + 1, memory_order_release);
+}
+
+/* A cpu write to 0x2000-0x2007, address already folded into that range */
+static inline void render_write(renderer* r, int64_t cycle, uint16_t address, uint8_t value)
+{
+	uint8_t reg = address & 0x07;
+
+	if (reg == 5 || reg == 6) {
+		r->queue.latch ^= 1;
+	}
+	render_push(r, cycle, PPU_WRITE, reg, value);
+}
+
+/*
+* A cpu read of 0x2000-0x2007. Only two change the ppu: 0x2002 clears the
+* write toggle, which is only worth an event when it is set, and 0x2007
+* moves the vram address.
+*/
+static inline void render_read(renderer* r, int64_t cycle, uint16_t address)
+{
+	uint8_t reg = address & 0x07;
+
+	if (reg == 2 && r->queue.latch) {
+		r->queue.latch = 0;
+		render_push(r, cycle, PPU_READ, reg, 0);
+	} else if (reg == 7) {
+		render_push(r, cycle, PPU_READ, reg, 0);
+	}
+}
+
+#endif
@@ -0,0 +1,53 @@
+#include <stdint.h>
+#include <stddef.h>
+#include "machine.h"
+#include "hash.h"
+
+#define FNV_PRIME 0x100000001B3ULL
+#define RAM_SIZE 2048
+
+/* FNV-1a over size bytes, chain calls by passing the last hash back in */
+uint64_t hash_bytes(const void* data, size_t size, uint64_t hash)
+{
+	const uint8_t* bytes = (const uint8_t*) data;
+	size_t i;
+
+	for (i = 0; i < size; i++) {
+		hash ^= bytes[i];
+		hash *= FNV_PRIME;
+	}
+
+	return hash;
+}
+
+/* Identifies the cartridge, prg and chr rom only */
+uint64_t rom_hash(machine* mch)
+{
+	uint64_t hash = hash_bytes(mch->prg_rom, mch->prg_rom_size, HASH_SEED);
+	return hash_bytes(mch->chr_rom, mch->chr_rom_size, hash);
+}
+
+/* Identifies everything that decides what the machine does next */
+uint64_t state_hash(machine* mch)
+{
+	uint8_t regs[7];
+	uint64_t hash;
+
+	regs[0] = mch->cpu.A;
+	regs[1] = mch->cpu.X;
+	regs[2] = mch->cpu.Y;
+	regs[3] = mch->cpu.P;
+	regs[4] = mch->cpu.S;
+	regs[5] = mch->cpu.pc & 0xFF;
+	regs[6] = mch->cpu.pc >> 8;
+
+	hash = hash_bytes(regs, sizeof(regs), HASH_SEED);
+	hash = hash_bytes(&mch->cpu.cycle, sizeof(mch->cpu.cycle), hash);
+	hash = hash_bytes(mch->memory, RAM_SIZE, hash);
+	hash = hash_bytes(mch->prg_ram, mch->prg_ram_size, hash);
+	hash = hash_bytes(mch->ppu_reg, sizeof(mch->ppu_reg), hash);
+	hash = hash_bytes(mch->io_reg, sizeof(mch->io_reg), hash);
+	hash = hash_bytes(&mch->ppu, sizeof(mch->ppu), hash);
+	hash = hash_bytes(mch->pad_shift, sizeof(mch->pad_shift), hash);
+	return hash_bytes(&mch->strobe, sizeof(mch->strobe), hash);
+}
@@ -0,0 +1,14 @@
+#ifndef HASH_H
+#define HASH_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "machine.h"
+
+#define HASH_SEED 0xCBF29CE484222325ULL // FNV-1a 64 bit offset basis
+
+uint64_t hash_bytes(const void* data, size_t size, uint64_t hash);
+uint64_t rom_hash(machine* mch);
+uint64_t state_hash(machine* mch);
+
+#endif
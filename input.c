@@ -0,0 +1,63 @@
+#include <stdint.h>
+#include "machine.h"
+#include "input.h"
+
+#define OPEN_BUS 0x40 // upper bits of 0x4016/0x4017 usually read back as 0x40
+
+/*
+* Hand the machine all of its input up front, two bytes per frame (port 0
+* then port 1). The buffer is not copied and has to outlive the run. Reads
+* of the controller ports are then served from it without calling back
+* into the host. arena_reset keeps it and starts again at its first frame.
+*/
+void input_inject(machine* mch, const uint8_t* frames, long num_frames)
+{
+	mch->input = frames;
+	mch->input_frames = num_frames;
+	mch->input_frame = 0;
+}
+
+/*
+* Latch the next frame of injected input into the controllers, called by
+* the run loop at every frame boundary. Past the end of the buffer all
+* buttons are released. Returns 1 while there was input left.
+*/
+int input_next_frame(machine* mch)
+{
+	if (mch->input && mch->input_frame < mch->input_frames) {
+		mch->pad[0] = mch->input[2 * mch->input_frame];
+		mch->pad[1] = mch->input[2 * mch->input_frame + 1];
+		mch->input_frame++;
+		return 1;
+	}
+
+	mch->pad[0] = 0;
+	mch->pad[1] = 0;
+	return 0;
+}
+
+/* Shift one button out of a controller, A first and right last */
+uint8_t read_controller(machine* mch, int port)
+{
+	uint8_t bit;
+
+	// while strobe is high the shift register keeps reloading, so it always reads A
+	if (mch->strobe & 1) {
+		return OPEN_BUS | (mch->pad[port] & 1);
+	}
+
+	bit = mch->pad_shift[port] & 1;
+	// official controllers read 1 once all eight buttons are out
+	mch->pad_shift[port] = (mch->pad_shift[port] >> 1) | 0x80;
+	return OPEN_BUS | bit;
+}
+
+/* Writing 1 then 0 to 0x4016 latches both controllers */
+void write_strobe(machine* mch, uint8_t value)
+{
+	if ((mch->strobe | value) & 1) {
+		mch->pad_shift[0] = mch->pad[0];
+		mch->pad_shift[1] = mch->pad[1];
+	}
+	mch->strobe = value & 1;
+}
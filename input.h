@@ -0,0 +1,23 @@
+#ifndef INPUT_H
+#define INPUT_H
+
+#include <stdint.h>
+#include "machine.h"
+
+#define BUTTON_A 0x01
+#define BUTTON_B 0x02
+#define BUTTON_SELECT 0x04
+#define BUTTON_START 0x08
+#define BUTTON_UP 0x10
+#define BUTTON_DOWN 0x20
+#define BUTTON_LEFT 0x40
+#define BUTTON_RIGHT 0x80
+
+void input_inject(machine* mch, const uint8_t* frames, long num_frames);
+int input_next_frame(machine* mch);
+
+// used by the memory slow path for 0x4016 and 0x4017
+uint8_t read_controller(machine* mch, int port);
+void write_strobe(machine* mch, uint8_t value);
+
+#endif
@@ -1,6 +1,8 @@
 #include <stdint.h>
+#include <string.h>
 #include "io.h"
 #include "machine.h"
+#include "arena.h"
 #define PRINT_IO 0
 
 /* Print the bits in an uint8_t */
@@ -27,60 +29,68 @@ void print_bits16(uint16_t x)
 	fprintf(stdout,"\n");
 }
 
+/* Print the registers, one line per instruction when tracing */
+void print_machine_state(machine* mch)
+{
+	fprintf(stdout, "pc:%04x A:%02x X:%02x Y:%02x P:%02x S:%02x\n",
+		mch->cpu.pc, mch->cpu.A, mch->cpu.X, mch->cpu.Y, mch->cpu.P, mch->cpu.S);
+}
 
-void read_ines(machine* mch, FILE* fp)
+/*
+* Sizes and file offsets from the 16 byte iNES header. Returns 0, or -1 if
+* this is not an iNES header.
+*/
+int parse_ines_header(const uint8_t* header, ines_info* info)
 {
-	int prg_rom_size, chr_rom_size;
-	uint8_t flags6, flags7, flags9, flags10;
-	int prg_ram_size;
+	if (header[0] != 'N' || header[1] != 'E' || header[2] != 'S' || header[3] != 0x1A) {
+		return -1;
+	}
 
-	// read header
-	fseek(fp, 4, SEEK_SET); // skip past NES and MS-DOS newline
-	prg_rom_size = fgetc(fp) * 16384;
-	chr_rom_size = fgetc(fp) * 8192;
-	flags6 = fgetc(fp);
-	flags7 = fgetc(fp);
-	prg_ram_size = fgetc(fp);
-	prg_ram_size = 0 ? 8192 : 8192 * prg_ram_size;
-	flags9 = fgetc(fp);
-	flags10 = fgetc(fp); // unofficial
-	fseek(fp, 5, SEEK_CUR);
+	info->prg_rom_size = header[4] * 16384;
+	info->chr_rom_size = header[5] * 8192;
+	info->prg_ram_size = header[8] == 0 ? 8192 : 8192 * header[8]; // 0 means 8KB for compatibility
+	// flags 6 bit 0: vertical mirroring, bit 3 four screen is treated the same
+	info->mirroring = (header[6] & 0x09) ? MIRROR_VERTICAL : MIRROR_HORIZONTAL;
+	// flags 6 bit 2: a 512 byte trainer sits between the header and the prg rom
+	info->prg_offset = INES_HEADER_SIZE + ((header[6] & 0x04) ? 512 : 0);
+	info->chr_offset = info->prg_offset + info->prg_rom_size;
+	// todo: playchoice inst-rom and prom, the title
+	return 0;
+}
 
-	// allocate memory for rom/ram
-	mch->prg_rom = (uint8_t*) malloc(prg_rom_size * sizeof(uint8_t));
-	if (!mch->prg_rom) {
-		fprintf(stderr, "Could not allocate memory!\n");
-		exit(-1);
-	}
+/*
+* Load a rom file into a new machine arena (see arena.h) and store it in
+* *out, to be freed with free(). Returns INES_OK, INES_BAD_FILE if the file
+* is not an iNES rom or is cut short, or INES_NO_MEMORY.
+*/
+int read_ines(FILE* fp, machine** out)
+{
+	uint8_t header[INES_HEADER_SIZE];
+	ines_info info;
+	arena_layout layout;
+	machine* mch;
+	void* base;
 
-	mch->chr_rom = (uint8_t*) malloc(chr_rom_size * sizeof(uint8_t));
-	if (!mch->chr_rom) {
-		fprintf(stderr, "Could not allocate memory!\n");
-		exit(-1);
+	if (fread(header, 1, INES_HEADER_SIZE, fp) != INES_HEADER_SIZE || parse_ines_header(header, &info) != 0) {
+		return INES_BAD_FILE;
 	}
 
-	mch->memory = (uint8_t*) malloc(2048 * sizeof(uint8_t));
-	if (!mch->memory) {
-		fprintf(stderr, "Could not allocate memory!\n");
-		exit(-1);
+	arena_plan(&info, &layout);
+	base = aligned_alloc(ARENA_ALIGN, layout.size);
+	if (!base) {
+		return INES_NO_MEMORY;
 	}
+	memset(base, 0, layout.prg_rom);
+	mch = arena_init(base, &info);
 
-	mch->prg_ram = (uint8_t*) malloc(prg_ram_size * sizeof(uint8_t));
-	if (!mch->prg_ram) {
-		fprintf(stderr, "Could not allocate memory!\n");
-		exit(-1);
+	// read in the prg rom data, then the chr rom data
+	if (fseek(fp, info.prg_offset, SEEK_SET) != 0
+		|| fread(mch->prg_rom, 1, info.prg_rom_size, fp) != (size_t) info.prg_rom_size
+		|| fread(mch->chr_rom, 1, info.chr_rom_size, fp) != (size_t) info.chr_rom_size) {
+		free(base);
+		return INES_BAD_FILE;
 	}
 
-	// read in the prg rom data
-	int i, j;
-	for (i = 0; i < prg_rom_size; i++){
-		mch->prg_rom[i] = fgetc(fp);
-	}
-	// read in the chr rom data
-	for (i = 0; i < chr_rom_size; i++){
-		mch->chr_rom[i] = fgetc(fp);
-	}
-	// todo: read in playchoice inst-rom if present
-	// todo: read in playchoide prom if present
-	// todo: read the 127 or 128 byte title if present
+	*out = mch;
+	return INES_OK;
 }
@@ -7,11 +7,34 @@
 #include <stdlib.h>
 #include "machine.h"
 
+// set to 0 to build without the per-instruction trace
+#ifndef DEBUG
+#define DEBUG 1
+#endif
+
 // debugging routines
 void print_bits(uint8_t x);
 void print_bits16(uint16_t x);
+void print_machine_state(machine* mch);
+
+#define INES_HEADER_SIZE 16
+
+#define INES_OK 0
+#define INES_BAD_FILE -1
+#define INES_NO_MEMORY -2
+
+// where everything is in an iNES file
+typedef struct ines_info {
+	int prg_rom_size;
+	int chr_rom_size;
+	int prg_ram_size;
+	uint8_t mirroring;
+	long prg_offset;
+	long chr_offset;
+} ines_info;
 
 // non debugging
-uint8_t* read_rom (uint8_t* memory, FILE* fp);
+int parse_ines_header(const uint8_t* header, ines_info* info);
+int read_ines(FILE* fp, machine** out);
 
 #endif
\ No newline at end of file
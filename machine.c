@@ -1,6 +1,11 @@
 #include <stdio.h>
 #include <stdint.h>
 #include "machine.h"
+#include "watch.h"
+#include "input.h"
+#include "decode.h"
+#include "graphics.h"
+#include "sound.h"
 
 #define RAM 0
 #define PRGROM 1
@@ -37,71 +42,150 @@ char map_mem(uint16_t address)
 	return -1;
 }
 
-/* write to RAM */
-void write_mem(machine* mch, uint16_t address, uint8_t value)
+/* Host memory behind an address, NULL for registers, open bus and writes to rom */
+static uint8_t* host_address(machine* mch, uint16_t address, char writing)
 {
-	char location = map_mem(address);
-	int i = 0;
-	uint16_t mregadr = 0x2000;
-	uint16_t curradr = 0x2008;
-	uint8_t* memory = mch->memory;
-
-	switch(location) {
+	switch(map_mem(address)) {
 		case RAM:
-			memory[address] = value;
+			// 2KB of ram mirrored four times
+			return &mch->memory[address & 0x07FF];
 
-			if (address == 0x0000) {
-				memory[0x0800] = value;
-				memory[0x1000] = value;
-				memory[0x1800] = value;
+		case SRAM:
+			if (mch->prg_ram_size == 0) {
+				return NULL;
 			}
+			return &mch->prg_ram[(address - 0x6000) % mch->prg_ram_size];
 
-			break;
-
-		case REGISTER:
-			memory[address] = value;
-			// mirror of 0x2000-0x2008 every 8 bytes
-			if (address >= 0x2000 && address <= 0x2008) {
-				for (i = 0; i < 0x1FF8; i += 8) {
-					memory[curradr++] = memory[mregadr++];
-					memory[curradr++] = memory[mregadr++];
-					memory[curradr++] = memory[mregadr++];
-					memory[curradr++] = memory[mregadr++];
-					memory[curradr++] = memory[mregadr++];
-					memory[curradr++] = memory[mregadr++];
-					memory[curradr++] = memory[mregadr++];
-					memory[curradr++] = memory[mregadr++];
-					memory[curradr++] = memory[mregadr++];
-					mregadr = 0x2000;
-				}
+		case PRGROM:
+			// a single 16KB bank is mirrored into 0xC000-0xFFFF
+			if (writing || mch->prg_rom_size == 0) {
+				return NULL;
 			}
-			break;
+			return &mch->prg_rom[(address - 0x8000) % mch->prg_rom_size];
+	}
 
-		case EXPANSION_ROM:
-		case SRAM:
-		case PRGROM:
-		case CHRROM:
-			memory[address] = value;
-			break;
+	return NULL;
+}
+
+/*
+* Build the page table from the cartridge layout. Pages that need more than
+* a plain load or store (registers, watched pages) are left NULL so that
+* read_mem and write_mem fall through to the slow path.
+*/
+void map_pages(machine* mch)
+{
+	int page;
+
+	for (page = 0; page < NUM_PAGES; page++) {
+		uint16_t address = (uint16_t) (page << 8);
+		mch->read_page[page] = host_address(mch, address, 0);
+		mch->write_page[page] = host_address(mch, address, 1);
+		mch->fetch_page[page] = mch->read_page[page];
+		mch->decode_page[page] = NULL;
+		if (mch->decoded && map_mem(address) == PRGROM && mch->prg_rom_size) {
+			mch->decode_page[page] = &mch->decoded[(address - 0x8000) % mch->prg_rom_size];
+		}
+	}
+
+	if (mch->watch) {
+		watch_unmap_pages(mch);
 	}
 }
 
-/* read from appropriate memory location */
-uint8_t read_mem(machine* mch, uint16_t address)
+/* Read without watchpoints or side effects */
+uint8_t peek_mem(machine* mch, uint16_t address)
 {
-	char location = map_mem(address);
-	uint8_t* memory = mch->memory;
-	uint8_t* prgrom = mch->prg_rom;
-	uint8_t* chrrom = mch->chr_rom;
+	uint8_t* host = host_address(mch, address, 0);
 
-	switch(location) {
-		case RAM: return memory[address];
-		case REGISTER: return memory[address];
-		case EXPANSION_ROM: return 0;
-		case SRAM: return 0;
-		case PRGROM: return prgrom[address];
-		case CHRROM: return chrrom[address];
+	if (host) {
+		return *host;
 	}
 
-	return -1;
-}
\ No newline at end of file
+	if (map_mem(address) == REGISTER) {
+		if (address < 0x4000) {
+			// 0x2004 reads oam at oam_addr without moving it
+			if ((address & 0x07) == 0x04) {
+				return mch->ppu.oam[mch->ppu.oam_addr];
+			}
+			return mch->ppu_reg[address & 0x07];
+		}
+		return mch->io_reg[address - 0x4000];
+	}
+
+	return 0; // open bus
+}
+
+/* read from appropriate memory location, for pages without a fast path */
+uint8_t read_mem_slow(machine* mch, uint16_t address)
+{
+	uint8_t value;
+
+	if (address == 0x4016 || address == 0x4017) {
+		value = read_controller(mch, address - 0x4016);
+	} else {
+		value = peek_mem(mch, address);
+	}
+
+	if (mch->render && address >= 0x2000 && address < 0x4000) {
+		render_read(mch->render, mch->cpu.cycle, address);
+	}
+
+	if (mch->watch) {
+		watch_access(mch, address, value, WATCH_READ);
+	}
+
+	return value;
+}
+
+/* write to memory, for pages without a fast path */
+void write_mem_slow(machine* mch, uint16_t address, uint8_t value)
+{
+	uint8_t* host = host_address(mch, address, 1);
+
+	if (mch->watch) {
+		watch_access(mch, address, value, WATCH_WRITE);
+	}
+
+	if (host) {
+		*host = value;
+		return;
+	}
+
+	if (map_mem(address) == REGISTER) {
+		// 0x2000-0x2007 are mirrored every 8 bytes
+		if (address < 0x4000) {
+			mch->ppu_reg[address & 0x07] = value;
+			address = 0x2000 | (address & 0x07);
+			if (mch->render) {
+				render_write(mch->render, mch->cpu.cycle, address, value);
+			}
+		} else {
+			mch->io_reg[address - 0x4000] = value;
+		}
+
+		switch(address) {
+			case 0x2003: mch->ppu.oam_addr = value; break;
+			case 0x2004: mch->ppu.oam[mch->ppu.oam_addr++] = value; break;
+			case 0x4011:
+				// the dmc's 7 bit dac, loaded directly
+				if (mch->audio) {
+					audio_level(mch->audio, mch->cpu.cycle, value & 0x7F);
+				}
+				break;
+			case 0x4014: oam_dma(mch, value); break;
+			case 0x4016: write_strobe(mch, value); break;
+		}
+	}
+}
+
+/* fetch an opcode from a page with an execute watchpoint or the heatmap on */
+uint8_t fetch_mem_slow(machine* mch, uint16_t address)
+{
+	uint8_t value = peek_mem(mch, address);
+
+	if (mch->watch) {
+		watch_access(mch, address, value, WATCH_EXEC);
+	}
+
+	return value;
+}
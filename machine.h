@@ -1,22 +1,180 @@
 #ifndef MACHINE_H
 #define MACHINE_H
 
-// structure that contains all info about the machine at current time
-typedef struct machine {
+#include <stdint.h>
+#include "ppu.h"
+
+#define NUM_PAGES 256 // 256 byte pages in the cpu address space
+
+// nametable layout, from the iNES header
+#define MIRROR_HORIZONTAL 0
+#define MIRROR_VERTICAL 1
+
+// for the cpu core, which only stays in registers if every handler is inlined
+#define ALWAYS_INLINE inline __attribute__((always_inline))
+
+struct watch_state;
+struct renderer;
+struct audio_out;
+struct decoded_op;
+
+/*
+* The state every instruction touches, one cache line at the front of the
+* machine (and so of its arena). run_cpu stops when cycle reaches
+* deadline, so anything due at a known cycle only has to pull the
+* deadline in instead of being checked after every instruction.
+*/
+typedef struct cpu_core {
 	uint8_t A; // accumulator
 	uint8_t X; // x index
 	uint8_t Y; // y index
 	uint8_t P; // processor status
 	uint8_t S; // stack
+	uint8_t status; // CPU_RUNNING until the cpu stops, see cpu.h
 	uint16_t pc; // program counter
+	int64_t cycle; // cycles since power on
+	int64_t deadline; // cycle of the next event
+} __attribute__((aligned(64))) cpu_core;
+
+_Static_assert(sizeof(cpu_core) == 64, "cpu_core should fill one cache line");
+
+/* The last pass around an idle loop, see fused_idle */
+typedef struct idle_loop {
+	uint16_t pc; // the branch closing the loop
+	uint8_t A, X, Y, P;
+	int64_t cycle; // when the pass started, -1 if there is none to compare with
+} idle_loop;
+
+/*
+* structure that contains all info about the machine at current time.
+* Apart from cpu, everything here is configuration or only used off the
+* fast path.
+*/
+typedef struct machine {
+	cpu_core cpu;
 	uint8_t* memory;
 	uint8_t* prg_rom;
 	uint8_t* chr_rom;
 	uint8_t* prg_ram;
-	int cycle;
+	int prg_rom_size;
+	int chr_rom_size;
+	int prg_ram_size;
+	uint8_t mirroring; // MIRROR_HORIZONTAL or MIRROR_VERTICAL
+	uint8_t ppu_reg[8]; // 0x2000-0x2007, mirrored up to 0x3FFF
+	uint8_t io_reg[0x20]; // 0x4000-0x401F
+	ppu_state ppu;
+	uint8_t pad[2]; // buttons held on each controller this frame, bit 0 = A ... bit 7 = right
+	uint8_t pad_shift[2]; // controller shift registers, read out one bit at a time
+	uint8_t strobe; // last value written to bit 0 of 0x4016
+	const uint8_t* input; // injected input, two bytes per frame, NULL if none
+	long input_frames;
+	long input_frame; // next frame to latch from input
+	// host memory behind each page, NULL sends the access down the slow path
+	uint8_t* read_page[NUM_PAGES];
+	uint8_t* write_page[NUM_PAGES];
+	uint8_t* fetch_page[NUM_PAGES];
+	struct decoded_op* decoded; // predecoded instructions, one per byte of prg rom, NULL if none
+	struct decoded_op* decode_page[NUM_PAGES]; // decoded behind each page, NULL where fetches go through fetch_mem
+	idle_loop idle;
+	struct watch_state* watch; // NULL unless watchpoints or the heatmap are on
+	struct renderer* render; // NULL unless frames are drawn, see graphics.h
+	struct audio_out* audio; // NULL unless sound is resampled, see sound.h
 } machine;
 
 char map_mem(uint16_t address);
-uint8_t read_mem(machine* mch, uint16_t address);
+void map_pages(machine* mch);
+uint8_t peek_mem(machine* mch, uint16_t address);
+uint8_t read_mem_slow(machine* mch, uint16_t address);
+void write_mem_slow(machine* mch, uint16_t address, uint8_t value);
+uint8_t fetch_mem_slow(machine* mch, uint16_t address);
+
+/* read from appropriate memory location */
+static inline uint8_t read_mem(machine* mch, uint16_t address)
+{
+	uint8_t* page = mch->read_page[address >> 8];
+	if (page) {
+		return page[address & 0xFF];
+	}
+	return read_mem_slow(mch, address);
+}
+
+/* write to RAM */
+static inline void write_mem(machine* mch, uint16_t address, uint8_t value)
+{
+	uint8_t* page = mch->write_page[address >> 8];
+	if (page) {
+		page[address & 0xFF] = value;
+		return;
+	}
+	write_mem_slow(mch, address, value);
+}
+
+/* read an opcode, kept apart from read_mem so execute watchpoints can trap it */
+static inline uint8_t fetch_mem(machine* mch, uint16_t address)
+{
+	uint8_t* page = mch->fetch_page[address >> 8];
+	if (page) {
+		return page[address & 0xFF];
+	}
+	return fetch_mem_slow(mch, address);
+}
+
+/* Copy the registers between the interpreter's locals and the machine */
+static ALWAYS_INLINE void cpu_copy(cpu_core* to, const cpu_core* from)
+{
+	to->A = from->A;
+	to->X = from->X;
+	to->Y = from->Y;
+	to->P = from->P;
+	to->S = from->S;
+	to->status = from->status;
+	to->pc = from->pc;
+	to->cycle = from->cycle;
+	to->deadline = from->deadline;
+}
+
+/*
+* The same three for the interpreter loop, which runs on a copy of the
+* cpu_core in locals. The slow paths can see or change it (watchpoints
+* print pc, dma adds cycles), so the copy goes back to mch->cpu before
+* them and is reloaded after. The fast paths leave it alone.
+*/
+static ALWAYS_INLINE uint8_t cpu_read(cpu_core* cpu, machine* mch, uint16_t address)
+{
+	uint8_t* page = mch->read_page[address >> 8];
+	uint8_t value;
+	if (page) {
+		return page[address & 0xFF];
+	}
+	cpu_copy(&mch->cpu, cpu);
+	value = read_mem_slow(mch, address);
+	cpu_copy(cpu, &mch->cpu);
+	return value;
+}
+
+static ALWAYS_INLINE void cpu_write(cpu_core* cpu, machine* mch, uint16_t address, uint8_t value)
+{
+	uint8_t* page = mch->write_page[address >> 8];
+	if (page) {
+		page[address & 0xFF] = value;
+		return;
+	}
+	cpu_copy(&mch->cpu, cpu);
+	write_mem_slow(mch, address, value);
+	cpu_copy(cpu, &mch->cpu);
+}
+
+static ALWAYS_INLINE uint8_t cpu_fetch(cpu_core* cpu, machine* mch, uint16_t address)
+{
+	uint8_t* page = mch->fetch_page[address >> 8];
+	uint8_t value;
+	if (page) {
+		return page[address & 0xFF];
+	}
+	cpu_copy(&mch->cpu, cpu);
+	value = fetch_mem_slow(mch, address);
+	cpu_copy(cpu, &mch->cpu);
+	return value;
+}
 
-#endif
\ No newline at end of file
+#endif
@@ -1,169 +1,272 @@
 #include <stdint.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include "machine.h"
-#include "opcodes.h"
+#include "cpu.h"
 #include "io.h"
 #include "graphics.h"
+#include "video.h"
+#include "framehash.h"
 #include "sound.h"
+#include "profiler.h"
+#include "watch.h"
+#include "hash.h"
+#include "movie.h"
+#include "codemap.h"
+#include "decode.h"
 
-#define INIT_PC 0 // placeholder
 #define INTERRUPT_PERIOD 100 // placeholder
-#define DEBUG 1
+#define PROF_CAPACITY 65536 // samples kept in the ring buffer
+#define PROF_PERIOD 1000 // default cycles between samples
+#define MAX_PATH 4096
 
-void execute_cpu(machine* m);
+static profiler* prof = NULL;
+static FILE* prof_fp = NULL;
+static machine* heat_mch = NULL;
+static FILE* heat_fp = NULL;
 
-// run appropriate function for opcode in memory
-void execute_cpu(machine* mch)
+/* Flush the profile on the way out, also registered with atexit() */
+static void dump_profile(void)
 {
-	uint8_t *opcode = &mch->memory[mch->pc++];
-	uint8_t *memory = mch->memory;
-
-	fprintf(stdout, "opcode: %x\n", opcode[0]);
-
-	switch(*opcode) {
-		case 0x02: exit(123);
-		case 0x12: exit(123);
-		case 0x22: exit(123);
-		case 0x32: exit(123);
-		case 0x42: exit(123);
-		case 0x52: exit(123);
-		case 0x62: exit(123);
-		case 0x72: exit(123);
-		case 0x92: exit(123);
-		case 0xB2: exit(123);
-		case 0xD2: exit(123);
-		case 0xF2: exit(123);
-		case 0xEA: return nop(mch, 1);
-		case 0x1A: return nop(mch, 2); // illegal instruction (nop with 2 cycles)
-		case 0x7A: return nop(mch, 2); // same as above
-		case 0x69: return adc_imm(opcode[1], mch);
-		case 0x65: return adc_zp(opcode[1], mch);
-		case 0x75: return adc_zpx(opcode[1], mch);
-		case 0x6D: return adc_abs(opcode[2], opcode[1], mch);
-		case 0x7D: return adc_absx(opcode[2], opcode[1], mch);
-		case 0x79: return adc_absy(opcode[2], opcode[1], mch);
-		case 0x61: return adc_indx(opcode[2], opcode[1], mch);
-		case 0x71: return adc_indy(opcode[2], opcode[1], mch);
-		case 0x29: return and_imm(opcode[1], mch);
-		case 0x25: return and_zp(opcode[1], mch);
-		case 0x35: return and_zpx(opcode[1], mch);
-		case 0x2D: return and_abs(opcode[2], opcode[1], mch);
-		case 0x3D: return and_absx(opcode[2], opcode[1], mch);
-		case 0x39: return and_absy(opcode[2], opcode[1], mch);
-		case 0x21: return and_indx(opcode[2], opcode[1], mch);
-		case 0x31: return and_indy(opcode[2], opcode[1], mch);
-		case 0x0A: return asl_acc(mch);
-		case 0x06: return asl_zp(opcode[1], mch);
-		case 0x16: return asl_zpx(opcode[1], mch);
-		case 0x0E: return asl_abs(opcode[2], opcode[1], mch);
-		case 0x1E: return asl_absx(opcode[2], opcode[1], mch);
-		case 0x90: return branch_clear(opcode[2], opcode[1], mch, 0b00000001);
-		case 0xB0: return branch_set(opcode[2], opcode[1], mch, 0b00000001);
-		case 0xF0: return branch_set(opcode[2], opcode[1], mch, 0b00000010);
-		case 0x24: return bit_zp(opcode[1], mch);
-		case 0x2C: return bit_abs(opcode[2], opcode[1], mch);
-		case 0x30: return branch_set(opcode[2], opcode[1], mch, 0b10000000);
-		case 0xD0: return branch_clear(opcode[2], opcode[1], mch, 0b00000010);
-		case 0x10: return branch_clear(opcode[2], opcode[1], mch, 0b10000000);
-		case 0x00: return brk(mch);
-		case 0x50: return branch_clear(opcode[2], opcode[1], mch, 0b01000000);
-		case 0x70: return branch_set(opcode[2], opcode[1], mch, 0b01000000);
-		case 0x18: return clc(mch);
-		case 0x58: return cli(mch);
-		case 0xB8: return clv(mch);
-		case 0xC9: return cmp_imm(opcode[1], mch);
-		case 0xC5: return cmp_zp(opcode[1], mch);
-		case 0xD5: return cmp_zpx(opcode[1], mch);
-		case 0xCD: return cmp_abs(opcode[2], opcode[1], mch, 0, 0);
-		case 0xDD: return cmp_abs(opcode[2], opcode[1], mch, 1, mch->X);
-		case 0xD9: return cmp_abs(opcode[2], opcode[1], mch, 1, mch->Y);
-		case 0xC1: return cmp_indy(opcode[2], opcode[1], mch);
-		case 0xD1: return cmp_indx(opcode[2], opcode[1], mch);
-		case 0xE0: return cpx_imm(opcode[1], mch);
-		case 0xE4: return cpx_zp(opcode[1], mch);
-		case 0xEC: return cpx_abs(opcode[2], opcode[1], mch);
-		case 0xC0: return cpy_imm(opcode[1], mch);
-		case 0xC4: return cpy_zp(opcode[1], mch);
-		case 0xCC: return cpy_abs(opcode[2], opcode[1], mch);
-		case 0xC6: return dec_zp(opcode[1], mch);
-		case 0xD6: return dec_zpx(opcode[1], mch);
-		case 0xCE: return dec_abs(opcode[2], opcode[1], mch);
-		case 0xDE: return dec_absx(opcode[2], opcode[1], mch);
-		case 0xCA: return dex(mch);
-		case 0x88: return dey(mch);
-		case 0x49: return eor_imm(opcode[1], mch);
-		case 0x45: return eor_zp(opcode[1], mch);
-		case 0x55: return eor_zpx(opcode[1], mch);
-		case 0x4D: return eor_abs(opcode[2], opcode[1], mch);
-		case 0x5D: return eor_absx(opcode[2], opcode[1], mch);
-		case 0x59: return eor_absy(opcode[2], opcode[1], mch);
-		case 0x41: return eor_indx(opcode[2], opcode[1], mch);
-		case 0x51: return eor_indy(opcode[2], opcode[1], mch);
-		case 0xE6: return inc_zp(opcode[1], mch, 0, 0);
-		case 0xF6: return inc_zp(opcode[1], mch, 1, mch->X);
-		case 0xEE: return inc_abs(opcode[2], opcode[1], mch, 0, 0);
-		case 0xFE: return inc_abs(opcode[2], opcode[1], mch, 1, mch->X);
-		case 0xE8: return inx(mch);
-		case 0xC8: return iny(mch);
-		case 0x4C: return jmp_abs(opcode[2], opcode[1], mch);
-		case 0x6C: return jmp_ind(opcode[2], opcode[1], mch);
-		case 0x20: return jsr(opcode[2], opcode[1], mch);
-		case 0xA9: return lda_imm(opcode[1], mch);
-		case 0xA5: return lda_zp(opcode[1], mch, 0, 0);
-		case 0xB5: return lda_zp(opcode[1], mch, 1, mch->X);
-		case 0xAD: return lda_abs(opcode[2], opcode[1], mch, 0, 0);
-		case 0xBD: return lda_abs(opcode[2], opcode[1], mch, 1, mch->X);
-		case 0xB9: return lda_abs(opcode[2], opcode[1], mch, 1, mch->Y);
-		case 0xA1: return lda_indx(opcode[2], opcode[1], mch);
-		case 0xB1: return lda_indy(opcode[2], opcode[1], mch);
-		case 0xA2: return ldx_imm(opcode[1], mch);
-		case 0xA6: return ldx_zp(opcode[1], mch, 0, 0);
-		case 0xB6: return ldx_zp(opcode[1], mch, 1, mch->X);
-		case 0xAE: return ldx_abs(opcode[2], opcode[1], mch, 0, 0);
-		case 0xBE: return ldx_abs(opcode[2], opcode[1], mch, 1, mch->X);
-		case 0xA0: return ldy_imm(opcode[1], mch);
-		case 0xA4: return ldy_zp(opcode[1], mch, 0, 0);
-		case 0xB4: return ldy_zp(opcode[1], mch, 1, mch->X);
-		case 0xAC: return ldy_abs(opcode[2], opcode[1], mch, 0, 0);
-		case 0xBC: return ldy_abs(opcode[2], opcode[1], mch, 1, mch->X);
-		case 0x4A: return lsr_acc(mch);
-		case 0x46: return lsr_zp(opcode[1], mch);
-		case 0x56: return lsr_zpx(opcode[1], mch);
-		case 0x4E: return lsr_abs(opcode[2], opcode[1], mch);
-		case 0x5E: return lsr_absx(opcode[2], opcode[1], mch);
-		case 0x09: return or_imm(opcode[1], mch);
-		case 0x05: return or_zp(opcode[1], mch);
-		case 0x15: return or_zpx(opcode[1], mch);
-		case 0x0D: return or_abs(opcode[2], opcode[1], mch);
-		case 0x1D: return or_absx(opcode[2], opcode[1], mch);
-		case 0x19: return or_absy(opcode[2], opcode[1], mch);
-		case 0x01: return or_indx(opcode[2], opcode[1], mch);
-		case 0x11: return or_indy(opcode[2], opcode[1], mch);
-		case 0x48: return pha(mch);
-		case 0x08: return php(mch);
-		case 0x68: return pla(mch);
-		case 0x28: return plp(mch);
-		case 0x40: return rti(mch);
-		case 0x60: return rts(mch);
-		case 0x78: return sei(mch); 
-		case 0x38: return sec(mch);
-		case 0xAA: return tax(mch);
-		case 0xA8: return tay(mch);
-		case 0x8A: return txa(mch);
-		case 0x98: return tya(mch);
-
-		default:
-			fprintf(stdout, "unimplemented opcode!\n");
-			fprintf(stdout, "opcode in question: %x\n", opcode[0]);
-			exit(1);
-			break;
+	if (!prof) {
+		return;
 	}
+	if (profiler_dump(prof, prof_fp) != 0) {
+		fprintf(stderr, "Could not write profile.\n");
+	}
+	fclose(prof_fp);
+	profiler_destroy(prof);
+	prof = NULL;
+}
+
+/* Write the heatmap on the way out */
+static void dump_heatmap(void)
+{
+	if (!heat_mch) {
+		return;
+	}
+	if (heatmap_write_pgm(heat_mch, heat_fp) != 0) {
+		fprintf(stderr, "Could not write heatmap.\n");
+	}
+	fclose(heat_fp);
+	heat_mch = NULL;
+}
+
+/* Parse start-end:kinds, e.g. 0300-03ff:w or fffa:rx */
+static int parse_watch(const char* arg, uint16_t* start, uint16_t* end, uint8_t* kind)
+{
+	char* next;
+
+	*start = (uint16_t) strtoul(arg, &next, 16);
+	*end = *start;
+	if (*next == '-') {
+		*end = (uint16_t) strtoul(next + 1, &next, 16);
+	}
+	if (*next != ':') {
+		return -1;
+	}
+
+	*kind = 0;
+	for (next++; *next; next++) {
+		switch (*next) {
+			case 'r': *kind |= WATCH_READ; break;
+			case 'w': *kind |= WATCH_WRITE; break;
+			case 'x': *kind |= WATCH_EXEC; break;
+			default: return -1;
+		}
+	}
+
+	return *kind ? 0 : -1;
+}
+
+/*
+* Load the code map of the rom from dir/<rom hash>.map, or analyse the rom
+* and save the map there for next time. Returns NULL if out of memory.
+*/
+static code_map* load_code_map(machine* mch, const char* dir)
+{
+	char path[MAX_PATH];
+	code_map* map = NULL;
+	FILE* fp;
+
+	snprintf(path, sizeof(path), "%s/%016llx.map", dir, (unsigned long long) rom_hash(mch));
+
+	fp = fopen(path, "rb");
+	if (fp) {
+		map = code_map_load(fp);
+		fclose(fp);
+		if (map && (map->header.rom_hash != rom_hash(mch) || map->header.size != mch->prg_rom_size)) {
+			code_map_destroy(map);
+			map = NULL;
+		}
+	}
+
+	if (!map) {
+		map = code_map_create(mch);
+		fp = map ? fopen(path, "wb") : NULL;
+		if (fp) {
+			if (code_map_save(map, fp) != 0) {
+				fprintf(stderr, "Could not write code map '%s'.\n", path);
+			}
+			fclose(fp);
+		}
+	}
+
+	return map;
+}
+
+/*
+* Map dir/<rom hash>.dec, or build the decode cache from the code map and
+* save it there so the next process starts decoded. Returns NULL if out of
+* memory.
+*/
+static decode_cache* load_decode_cache(machine* mch, const code_map* map, const char* dir)
+{
+	char path[MAX_PATH];
+	decode_cache* cache;
+	code_map* own_map = NULL;
+	FILE* fp;
+
+	snprintf(path, sizeof(path), "%s/%016llx.dec", dir, (unsigned long long) rom_hash(mch));
+
+	cache = decode_cache_open(mch, path);
+	if (cache) {
+		return cache;
+	}
+
+	if (!map) {
+		map = own_map = code_map_create(mch);
+	}
+	cache = map ? decode_cache_create(mch, map) : NULL;
+	code_map_destroy(own_map);
+
+	fp = cache ? fopen(path, "wb") : NULL;
+	if (fp) {
+		if (decode_cache_save(cache, fp) != 0) {
+			fprintf(stderr, "Could not write decode cache '%s'.\n", path);
+		}
+		fclose(fp);
+	}
+
+	return cache;
 }
 
 int main(int argc, char* argv[])
 {
 	char running = 1; // avoid compiler treating a constant 1 as a variable, temporarily 0
+	int period = PROF_PERIOD;
+	int64_t max_cycles = 0; // 0 runs until the rom halts
+	FILE* movie_fp = NULL;
+	const char* map_dir = NULL;
+	code_map* map = NULL;
+	const char* decode_dir = NULL;
+	decode_cache* decode = NULL;
+	const char* render_mode = NULL;
+	renderer* render = NULL;
+	const char* video_path = NULL;
+	const char* png_arg = NULL;
+	FILE* video_fp = NULL;
+	video_out* video = NULL;
+	const char* trace_path = NULL;
+	FILE* golden_fp = NULL;
+	hash_trace* trace = NULL;
+	hash_trace* golden = NULL;
+	const char* audio_path = NULL;
+	const char* audio_arg = NULL;
+	FILE* audio_fp = NULL;
+	wav_file wav;
+	audio_out* audio = NULL;
+	const char* watches[MAX_WATCHPOINTS];
+	int num_watches = 0;
+	char* arg;
+	int status = 0;
+	int i;
+
+	// -p file: write samples to file, -s cycles: sample period
+	// -w range:rwx: add a watchpoint, -H file: write a heatmap
+	// -c cycles: stop after this many cycles, -m file: play a movie headless
+	// -a dir: find code in the rom, keeping the result in dir
+	// -d dir: run from predecoded instructions, keeping them in dir
+	// -r inline|thread: draw frames on the cpu thread, or pipelined on another
+	// -v file: stream the frames, yuv 4:2:0 for a .yuv file, rgba otherwise
+	// -n every:dir: write every n-th frame as a png into dir
+	// -t file: write the hash of every frame, -g file: compare them with a golden trace
+	// -S file: write the sound, wav for a .wav file, raw samples otherwise, null for none
+	// -l rate[:latency[:size]]: sample rate, ms per block and samples buffered
+	// every option takes an argument
+	for (i = 1; i + 1 < argc && argv[i][0] == '-'; i += 2) {
+		arg = argv[i + 1];
+		switch (argv[i][1]) {
+			case 'p':
+				prof_fp = fopen(arg, "wb");
+				if (prof_fp == NULL) {
+					fprintf(stderr, "Could not open file '%s'. Exiting.\n", arg);
+					exit(-1);
+				}
+				break;
+			case 's':
+				period = atoi(arg);
+				break;
+			case 'c':
+				max_cycles = atoll(arg);
+				break;
+			case 'm':
+				movie_fp = fopen(arg, "rb");
+				if (movie_fp == NULL) {
+					fprintf(stderr, "Could not open file '%s'. Exiting.\n", arg);
+					exit(-1);
+				}
+				break;
+			case 'w':
+				if (num_watches < MAX_WATCHPOINTS) {
+					watches[num_watches++] = arg;
+				}
+				break;
+			case 'a':
+				map_dir = arg;
+				break;
+			case 'd':
+				decode_dir = arg;
+				break;
+			case 'r':
+				render_mode = arg;
+				break;
+			case 'v':
+				video_path = arg;
+				break;
+			case 'n':
+				png_arg = arg;
+				break;
+			case 't':
+				trace_path = arg;
+				break;
+			case 'g':
+				golden_fp = fopen(arg, "rb");
+				if (golden_fp == NULL) {
+					fprintf(stderr, "Could not open file '%s'. Exiting.\n", arg);
+					exit(-1);
+				}
+				break;
+			case 'S':
+				audio_path = arg;
+				break;
+			case 'l':
+				audio_arg = arg;
+				break;
+			case 'H':
+				heat_fp = fopen(arg, "wb");
+				if (heat_fp == NULL) {
+					fprintf(stderr, "Could not open file '%s'. Exiting.\n", arg);
+					exit(-1);
+				}
+				break;
+			default:
+				fprintf(stderr, "usage: %s [-c cycles] [-m movie] [-p samples.prof] [-s period] [-w range:rwx] [-H heatmap.pgm] [-a mapdir] [-d decodedir] [-r inline|thread] [-v video.rgba|video.yuv] [-n every:pngdir] [-t trace.fht] [-g golden.fht] [-S sound.wav|sound.raw|null] [-l rate[:latency[:size]]] rom.nes\n", argv[0]);
+				exit(-1);
+		}
+	}
+	argv += i - 1;
 
 	FILE* fp;
 	fp = fopen(argv[1], "rb");
@@ -173,47 +276,316 @@ int main(int argc, char* argv[])
 		exit(-1);
 	}
 
-	machine* mch = (machine*) malloc(sizeof(mch));
-	
-	if (mch == NULL) {
-		fprintf(stderr, "Could not allocate memory. Exiting. \n");
-		exit(-2);
+	machine* mch = NULL;
+
+	switch (read_ines(fp, &mch)) {
+		case INES_BAD_FILE:
+			fprintf(stderr, "'%s' is not an iNES rom. Exiting.\n", argv[1]);
+			exit(-1);
+		case INES_NO_MEMORY:
+			fprintf(stderr, "Could not allocate memory. Exiting. \n");
+			exit(-2);
+	}
+
+	power_on(mch);
+
+	if (map_dir) {
+		uint32_t count[4] = {0, 0, 0, 0};
+		uint32_t j;
+
+		map = load_code_map(mch, map_dir);
+		if (map == NULL) {
+			fprintf(stderr, "Could not allocate memory. Exiting. \n");
+			exit(-2);
+		}
+		for (j = 0; j < map->header.size; j++) {
+			count[map->kind[j]]++;
+		}
+		fprintf(stdout, "code map: %u code, %u operand, %u table, %u unknown bytes\n", count[MAP_CODE], count[MAP_OPERAND], count[MAP_DATA], count[MAP_UNKNOWN]);
+	}
+
+	if (decode_dir) {
+		decode = load_decode_cache(mch, map, decode_dir);
+		if (decode == NULL) {
+			fprintf(stderr, "Could not allocate memory. Exiting. \n");
+			exit(-2);
+		}
+		decode_cache_attach(mch, decode);
 	}
 
-	mch->P = 0b00100000; // bit 5 is 1 at all times
-	mch->cycle = 0;
+	for (i = 0; i < num_watches; i++) {
+		uint16_t start, end;
+		uint8_t kind;
+		if (parse_watch(watches[i], &start, &end, &kind) != 0 || watch_add(mch, start, end, kind) != 0) {
+			fprintf(stderr, "Bad watchpoint '%s'. Exiting.\n", watches[i]);
+			exit(-1);
+		}
+	}
 
-	mch->stack = (uint8_t*) malloc(256 * sizeof(uint8_t));
+	if (heat_fp) {
+		if (heatmap_enable(mch) != 0) {
+			fprintf(stderr, "Could not allocate memory. Exiting. \n");
+			exit(-2);
+		}
+		heat_mch = mch;
+		atexit(dump_heatmap);
+	}
 
-	if (mch->stack == NULL) {
-		fprintf(stderr, "Could not allocate memory. Exiting. \n");
-		exit(-2);
+	// frames to write need frames drawn
+	if ((video_path || png_arg || trace_path || golden_fp) && !render_mode) {
+		render_mode = "inline";
 	}
 
-	mch->stack_head = 0;
+	if (render_mode) {
+		if (strcmp(render_mode, "inline") != 0 && strcmp(render_mode, "thread") != 0) {
+			fprintf(stderr, "Unknown render mode '%s'. Exiting.\n", render_mode);
+			exit(-1);
+		}
+		render = render_create(mch, strcmp(render_mode, "thread") == 0);
+		if (render == NULL) {
+			fprintf(stderr, "Could not start the renderer. Exiting. \n");
+			exit(-2);
+		}
+	}
+
+	if (video_path || png_arg) {
+		const char* png_dir = NULL;
+		int png_every = 0;
+		size_t length;
+
+		if (png_arg) {
+			png_every = atoi(png_arg);
+			png_dir = strchr(png_arg, ':');
+			if (png_every <= 0 || !png_dir) {
+				fprintf(stderr, "Bad snapshot option '%s', use every:dir. Exiting.\n", png_arg);
+				exit(-1);
+			}
+			png_dir++;
+		}
+		if (video_path) {
+			video_fp = fopen(video_path, "wb");
+			if (video_fp == NULL) {
+				fprintf(stderr, "Could not open file '%s'. Exiting.\n", video_path);
+				exit(-1);
+			}
+		}
+
+		length = video_path ? strlen(video_path) : 0;
+		video = video_open(video_fp, length >= 4 && strcmp(video_path + length - 4, ".yuv") == 0 ? VIDEO_YUV : VIDEO_RGBA, png_dir, png_every);
+		if (video == NULL || render_add_sink(render, video_frame, video) != 0) {
+			fprintf(stderr, "Could not start the video writer. Exiting. \n");
+			exit(-2);
+		}
+	}
+
+	if (golden_fp) {
+		golden = hash_trace_load(golden_fp);
+		if (golden == NULL) {
+			fprintf(stderr, "Could not read golden trace. Exiting.\n");
+			exit(-1);
+		}
+		fclose(golden_fp);
+	}
+
+	if (trace_path || golden) {
+		trace = hash_trace_create();
+		if (trace == NULL || render_add_sink(render, hash_trace_frame, trace) != 0) {
+			fprintf(stderr, "Could not allocate memory. Exiting. \n");
+			exit(-2);
+		}
+	}
 
-	read_file(mch, fp);
+	if (audio_path) {
+		int rate = 44100, latency = 20, size = 0;
+		audio_sink sink = raw_sink;
+		void* ctx = NULL;
+		size_t length = strlen(audio_path);
+
+		if (audio_arg && sscanf(audio_arg, "%d:%d:%d", &rate, &latency, &size) < 1) {
+			fprintf(stderr, "Bad sound option '%s', use rate[:latency[:size]]. Exiting.\n", audio_arg);
+			exit(-1);
+		}
+		if (rate < 8000 || rate > 192000 || latency < 0 || size < 0) {
+			fprintf(stderr, "Bad sound option '%s'. Exiting.\n", audio_arg);
+			exit(-1);
+		}
+
+		if (strcmp(audio_path, "null") == 0) {
+			sink = null_sink;
+		} else {
+			audio_fp = fopen(audio_path, "wb");
+			if (audio_fp == NULL) {
+				fprintf(stderr, "Could not open file '%s'. Exiting.\n", audio_path);
+				exit(-1);
+			}
+			ctx = audio_fp;
+			if (length >= 4 && strcmp(audio_path + length - 4, ".wav") == 0) {
+				if (wav_open(&wav, audio_fp, rate) != 0) {
+					fprintf(stderr, "Could not write file '%s'. Exiting.\n", audio_path);
+					exit(-1);
+				}
+				sink = wav_sink;
+				ctx = &wav;
+			}
+		}
+
+		audio = audio_create(mch, rate, latency, size, sink, ctx);
+		if (audio == NULL) {
+			fprintf(stderr, "Could not allocate memory. Exiting. \n");
+			exit(-2);
+		}
+	}
+
+	if (prof_fp) {
+		prof = profiler_create(PROF_CAPACITY, period);
+		if (prof == NULL) {
+			fprintf(stderr, "Could not allocate memory. Exiting. \n");
+			exit(-2);
+		}
+		atexit(dump_profile);
+	}
+
+	if (movie_fp) {
+		movie* mv = movie_load(movie_fp);
+		int result;
+
+		if (mv == NULL) {
+			fprintf(stderr, "Could not read movie. Exiting.\n");
+			exit(-1);
+		}
+
+		result = movie_play(mch, mv);
+		if (result == MOVIE_BAD_ROM) {
+			fprintf(stderr, "Movie was recorded on a different rom. Exiting.\n");
+			exit(-1);
+		}
+		if (result == MOVIE_BAD_STATE) {
+			fprintf(stderr, "Movie starts from a different state. Exiting.\n");
+			exit(-1);
+		}
+		if (result == MOVIE_NO_MEMORY) {
+			fprintf(stderr, "Could not allocate memory. Exiting. \n");
+			exit(-2);
+		}
+
+		fprintf(stdout, "%u frames, state %016llx\n", mv->header.num_frames, (unsigned long long) state_hash(mch));
+		movie_destroy(mv);
+		fclose(movie_fp);
+		running = 0;
+	}
 
 	while(running){
-		print_machine_state(mch);
-		execute_cpu(mch);
-		mch->pc += 1;
-		printf("cpu cycle: %d\n", mch->cycle);
+		if (DEBUG) {
+			print_machine_state(mch);
+			execute_cpu(mch);
+			printf("cpu cycle: %lld\n", (long long) mch->cpu.cycle);
+		} else {
+			// run to the next sample or the cycle limit in one go
+			int64_t until = max_cycles ? max_cycles : INT64_MAX;
+			if (prof && prof->next_sample < until) {
+				until = prof->next_sample;
+			}
+			// hand the renderer and the sound a frame at a time
+			if ((render || audio) && mch->cpu.cycle + FRAME_DOTS / 3 < until) {
+				until = mch->cpu.cycle + FRAME_DOTS / 3;
+			}
+			run_cpu(mch, until);
+		}
+		if (prof) {
+			profiler_tick(prof, mch);
+		}
+		if (max_cycles && mch->cpu.cycle >= max_cycles) {
+			running = 0;
+		}
+		if (mch->cpu.status != CPU_RUNNING) {
+			running = 0;
+		}
 		// check for interrupts
-		/*if ((mch->P & 0b00000100) != 0) {
+		/*if ((mch->cpu.P & 0b00000100) != 0) {
 			printf("Caught an interrupt\n");
-			mch->stack_head++;
-			mch->stack[mch->stack_head] = mch->pc;
-			mch->pc = ((uint16_t)mch->memory[0xFFFE] << 8) | mch->memory[0xFFFF];
+			push(mch, mch->cpu.pc >> 8);
+			push(mch, mch->cpu.pc & 0xFF);
+			mch->cpu.pc = ((uint16_t)mch->memory[0xFFFE] << 8) | mch->memory[0xFFFF];
 		}*/
-		//emulate_graphics(mch->memory);
 		//emulate_sound(mch->memory);
 	}
 
-	free(mch->memory);
-	free(mch->prg_rom);
-	free(mch->prg_ram);
-	free(mch->chr_rom);
+	dump_profile();
+	dump_heatmap();
+
+	if (render) {
+		render_finish(render);
+		fprintf(stdout, "%lld frames drawn\n", (long long) render->frames);
+		if (video_close(video) != 0) {
+			fprintf(stderr, "Could not write every frame.\n");
+			status = 2;
+		}
+		if (video_fp) {
+			fclose(video_fp);
+		}
+		if (trace) {
+			fprintf(stdout, "frame hash trace %016llx\n", (unsigned long long) hash_trace_digest(trace));
+			if (trace->failed) {
+				fprintf(stderr, "Could not allocate memory for every frame hash.\n");
+				status = 2;
+			}
+		}
+		if (trace_path) {
+			FILE* trace_fp = fopen(trace_path, "wb");
+			int failed = trace_fp == NULL || hash_trace_save(trace, trace_fp) != 0;
+			if (trace_fp && fclose(trace_fp) != 0) {
+				failed = 1;
+			}
+			if (failed) {
+				fprintf(stderr, "Could not write file '%s'.\n", trace_path);
+				status = 2;
+			}
+		}
+		if (golden) {
+			trace_diff diff;
+			hash_trace_compare(trace, golden, &diff);
+			fprintf(stdout, "golden: %llu frames differ, %llu visibly", (unsigned long long) diff.exact, (unsigned long long) diff.visible);
+			if (diff.first >= 0) {
+				fprintf(stdout, ", first at frame %lld", (long long) diff.first);
+				status = 3;
+			}
+			fprintf(stdout, "\n");
+		}
+		mch->render = NULL;
+		render_destroy(render);
+	}
+
+	if (audio) {
+		int failed = audio_finish(audio) != 0;
+		fprintf(stdout, "%lld samples at %d Hz\n", (long long) audio->samples, audio->rate);
+		if (audio_fp && audio->sink == wav_sink && wav_close(&wav) != 0) {
+			failed = 1;
+		}
+		if (audio_fp && fclose(audio_fp) != 0) {
+			failed = 1;
+		}
+		if (failed) {
+			fprintf(stderr, "Could not write every sample.\n");
+			status = 2;
+		}
+		mch->audio = NULL;
+		audio_destroy(audio);
+	}
+
+	if (mch->cpu.status == CPU_JAMMED) {
+		status = 123;
+	} else if (mch->cpu.status == CPU_BAD_OPCODE) {
+		fprintf(stdout, "unimplemented opcode!\n");
+		fprintf(stdout, "opcode in question: %x\n", peek_mem(mch, mch->cpu.pc));
+		status = 1;
+	}
+
+	watch_free(mch);
+	code_map_destroy(map);
+	decode_cache_destroy(decode);
+	hash_trace_destroy(trace);
+	hash_trace_destroy(golden);
 	free(mch);
 	fclose(fp);
+	return status;
 }
@@ -0,0 +1,177 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include "machine.h"
+#include "cpu.h"
+#include "hash.h"
+#include "movie.h"
+#include "input.h"
+
+/* Start an empty movie from the machine's current state */
+movie* movie_create(machine* mch)
+{
+	movie* mv = (movie*) calloc(1, sizeof(movie));
+
+	if (!mv) {
+		return NULL;
+	}
+
+	mv->header.magic = MOVIE_MAGIC;
+	mv->header.rom_hash = rom_hash(mch);
+	mv->header.state_hash = state_hash(mch);
+	return mv;
+}
+
+void movie_destroy(movie* mv)
+{
+	if (mv) {
+		free(mv->runs);
+		free(mv);
+	}
+}
+
+/* Add one frame of input. Returns 0 on success, -1 if out of memory. */
+int movie_append(movie* mv, uint8_t pad0, uint8_t pad1)
+{
+	movie_run* last = mv->header.num_runs ? &mv->runs[mv->header.num_runs - 1] : NULL;
+
+	if (last && last->pad[0] == pad0 && last->pad[1] == pad1 && last->frames < UINT16_MAX) {
+		last->frames++;
+		mv->header.num_frames++;
+		return 0;
+	}
+
+	if (mv->header.num_runs == mv->max_runs) {
+		uint32_t max_runs = mv->max_runs ? mv->max_runs * 2 : 256;
+		movie_run* runs = (movie_run*) realloc(mv->runs, max_runs * sizeof(movie_run));
+		if (!runs) {
+			return -1;
+		}
+		mv->runs = runs;
+		mv->max_runs = max_runs;
+	}
+
+	last = &mv->runs[mv->header.num_runs++];
+	last->frames = 1;
+	last->pad[0] = pad0;
+	last->pad[1] = pad1;
+	mv->header.num_frames++;
+	return 0;
+}
+
+/* Returns 0 on success */
+int movie_save(movie* mv, FILE* fp)
+{
+	if (fwrite(&mv->header, sizeof(movie_header), 1, fp) != 1) {
+		return -1;
+	}
+	if (fwrite(mv->runs, sizeof(movie_run), mv->header.num_runs, fp) != mv->header.num_runs) {
+		return -1;
+	}
+	return 0;
+}
+
+/* More runs than the file holds. Files that cannot be measured are left to fread. */
+static int runs_missing(FILE* fp, uint32_t num_runs)
+{
+	struct stat st;
+
+	return fstat(fileno(fp), &st) == 0 && S_ISREG(st.st_mode)
+		&& (uint64_t) st.st_size < sizeof(movie_header) + (uint64_t) num_runs * sizeof(movie_run);
+}
+
+/*
+* Returns NULL if the file is not a movie, is truncated, claims more runs
+* than frames, or its runs do not add up to num_frames, which movie_play
+* sizes its buffer from.
+*/
+movie* movie_load(FILE* fp)
+{
+	movie* mv = (movie*) calloc(1, sizeof(movie));
+	uint64_t frames = 0;
+	uint32_t i;
+
+	if (!mv) {
+		return NULL;
+	}
+
+	if (fread(&mv->header, sizeof(movie_header), 1, fp) != 1 || mv->header.magic != MOVIE_MAGIC) {
+		free(mv);
+		return NULL;
+	}
+
+	// every run is at least a frame, and all of them have to be in the file
+	if (mv->header.num_runs > mv->header.num_frames || runs_missing(fp, mv->header.num_runs)) {
+		free(mv);
+		return NULL;
+	}
+
+	mv->max_runs = mv->header.num_runs;
+	mv->runs = (movie_run*) malloc(((size_t) mv->max_runs + 1) * sizeof(movie_run));
+	if (!mv->runs || fread(mv->runs, sizeof(movie_run), mv->max_runs, fp) != mv->max_runs) {
+		movie_destroy(mv);
+		return NULL;
+	}
+
+	for (i = 0; i < mv->header.num_runs; i++) {
+		frames += mv->runs[i].frames;
+	}
+	if (frames != mv->header.num_frames) {
+		movie_destroy(mv);
+		return NULL;
+	}
+
+	return mv;
+}
+
+/*
+* Play the movie from the machine's current state as fast as the core goes.
+* The runs are expanded and injected up front, so controller reads never
+* leave the core. Nothing is rendered, mixed or written, so two runs of
+* the same movie always end in the same state. Frames are cut on the exact
+* ppu dot count so the fractional cycle never drifts. Returns MOVIE_OK,
+* MOVIE_BAD_ROM or MOVIE_BAD_STATE if the movie was recorded against
+* something else, or MOVIE_NO_MEMORY.
+*/
+int movie_play(machine* mch, movie* mv)
+{
+	int64_t start = mch->cpu.cycle;
+	long frame;
+	uint8_t* inputs;
+	uint8_t* next;
+	uint32_t i, j;
+
+	if (rom_hash(mch) != mv->header.rom_hash) {
+		return MOVIE_BAD_ROM;
+	}
+	if (state_hash(mch) != mv->header.state_hash) {
+		return MOVIE_BAD_STATE;
+	}
+
+	inputs = (uint8_t*) malloc(2 * (size_t) mv->header.num_frames + 2);
+	if (!inputs) {
+		return MOVIE_NO_MEMORY;
+	}
+
+	// never more than num_frames, whatever the runs say
+	next = inputs;
+	for (i = 0; i < mv->header.num_runs; i++) {
+		for (j = 0; j < mv->runs[i].frames && next < inputs + 2 * (size_t) mv->header.num_frames; j++) {
+			*next++ = mv->runs[i].pad[0];
+			*next++ = mv->runs[i].pad[1];
+		}
+	}
+
+	input_inject(mch, inputs, mv->header.num_frames);
+
+	for (frame = 1; frame <= mv->header.num_frames; frame++) {
+		input_next_frame(mch);
+		run_cpu(mch, start + frame * FRAME_DOTS / 3);
+	}
+
+	input_inject(mch, NULL, 0);
+	free(inputs);
+	return MOVIE_OK;
+}
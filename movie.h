@@ -0,0 +1,48 @@
+#ifndef MOVIE_H
+#define MOVIE_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include "machine.h"
+
+#define MOVIE_MAGIC 0x31564D4E // "NMV1"
+
+#define MOVIE_OK 0
+#define MOVIE_BAD_ROM -1
+#define MOVIE_BAD_STATE -2
+#define MOVIE_NO_MEMORY -3
+
+/*
+* A movie is the controller input for every frame, starting from a known
+* machine state. Input rarely changes from one frame to the next, so it is
+* stored as runs of identical frames.
+*/
+typedef struct movie_run {
+	uint16_t frames;
+	uint8_t pad[2];
+} movie_run;
+
+// file header, followed by num_runs runs
+typedef struct movie_header {
+	uint32_t magic;
+	uint32_t num_frames;
+	uint64_t rom_hash;
+	uint64_t state_hash; // state_hash() of the machine at frame 0
+	uint32_t num_runs;
+	uint32_t reserved;
+} movie_header;
+
+typedef struct movie {
+	movie_header header;
+	movie_run* runs;
+	uint32_t max_runs;
+} movie;
+
+movie* movie_create(machine* mch);
+void movie_destroy(movie* mv);
+int movie_append(movie* mv, uint8_t pad0, uint8_t pad1);
+int movie_save(movie* mv, FILE* fp);
+movie* movie_load(FILE* fp);
+int movie_play(machine* mch, movie* mv);
+
+#endif
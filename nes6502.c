@@ -0,0 +1,168 @@
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "machine.h"
+#include "cpu.h"
+#include "io.h"
+#include "hash.h"
+#include "arena.h"
+#include "nes6502.h"
+
+struct nes6502 {
+	machine* mch; // in the arena, NULL until a rom is loaded
+	void* block; // what the allocator returned for the arena
+	nes6502_allocator allocator;
+};
+
+static void* default_alloc(size_t size, void* user)
+{
+	return malloc(size);
+}
+
+static void default_free(void* ptr, void* user)
+{
+	free(ptr);
+}
+
+static void* nes_alloc(nes6502* nes, size_t size)
+{
+	return nes->allocator.alloc(size, nes->allocator.user);
+}
+
+static void nes_free(nes6502* nes, void* ptr)
+{
+	if (ptr) {
+		nes->allocator.free(ptr, nes->allocator.user);
+	}
+}
+
+// give back the arena
+static void unload(nes6502* nes)
+{
+	nes_free(nes, nes->block);
+	nes->block = NULL;
+	nes->mch = NULL;
+}
+
+// what the library reports for machine.status
+static int status_error(uint8_t status)
+{
+	switch (status) {
+		case CPU_JAMMED: return NES6502_JAMMED;
+		case CPU_BAD_OPCODE: return NES6502_BAD_OPCODE;
+	}
+	return NES6502_OK;
+}
+
+/* Returns NULL if out of memory */
+nes6502* nes6502_create(const nes6502_allocator* allocator)
+{
+	nes6502_allocator use = {default_alloc, default_free, NULL};
+	nes6502* nes;
+
+	if (allocator) {
+		use = *allocator;
+	}
+
+	nes = (nes6502*) use.alloc(sizeof(nes6502), use.user);
+	if (!nes) {
+		return NULL;
+	}
+
+	memset(nes, 0, sizeof(nes6502));
+	nes->allocator = use;
+	return nes;
+}
+
+/*
+* Load an iNES image from memory and power the machine on. The image is
+* copied, so it can be freed as soon as this returns. Loading again
+* replaces the rom. Returns NES6502_OK, NES6502_BAD_ROM or
+* NES6502_NO_MEMORY; the machine is left unloaded on failure.
+*/
+int nes6502_load(nes6502* nes, const uint8_t* rom, size_t size)
+{
+	ines_info info;
+	arena_layout layout;
+	uint8_t* base;
+	machine* mch;
+
+	unload(nes);
+
+	if (size < INES_HEADER_SIZE || parse_ines_header(rom, &info) != 0) {
+		return NES6502_BAD_ROM;
+	}
+	if ((size_t) info.chr_offset + info.chr_rom_size > size) {
+		return NES6502_BAD_ROM;
+	}
+
+	// the allocator only promises malloc alignment, so leave room to align by hand
+	arena_plan(&info, &layout);
+	nes->block = nes_alloc(nes, layout.size + ARENA_ALIGN - 1);
+	if (!nes->block) {
+		return NES6502_NO_MEMORY;
+	}
+	base = (uint8_t*) (((uintptr_t) nes->block + ARENA_ALIGN - 1) & ~(uintptr_t) (ARENA_ALIGN - 1));
+
+	memset(base, 0, layout.prg_rom);
+	mch = arena_init(base, &info);
+	memcpy(mch->prg_rom, rom + info.prg_offset, info.prg_rom_size);
+	memcpy(mch->chr_rom, rom + info.chr_offset, info.chr_rom_size);
+
+	power_on(mch);
+	nes->mch = mch;
+	return NES6502_OK;
+}
+
+/* Power cycle the machine, keeping the rom */
+int nes6502_reset(nes6502* nes)
+{
+	if (!nes->mch) {
+		return NES6502_NOT_LOADED;
+	}
+	arena_reset(nes->mch);
+	return NES6502_OK;
+}
+
+/* Run one instruction */
+int nes6502_step(nes6502* nes)
+{
+	if (!nes->mch) {
+		return NES6502_NOT_LOADED;
+	}
+	if (nes->mch->cpu.status == CPU_RUNNING) {
+		execute_cpu(nes->mch);
+	}
+	return status_error(nes->mch->cpu.status);
+}
+
+/* Run whole instructions for at least cycles cycles, or until the cpu stops */
+int nes6502_run(nes6502* nes, int64_t cycles)
+{
+	if (!nes->mch) {
+		return NES6502_NOT_LOADED;
+	}
+	run_cpu(nes->mch, nes->mch->cpu.cycle + cycles);
+	return status_error(nes->mch->cpu.status);
+}
+
+/* Cycles run since power on, 0 if nothing is loaded */
+int64_t nes6502_cycles(const nes6502* nes)
+{
+	return nes->mch ? nes->mch->cpu.cycle : 0;
+}
+
+/* Hash of the whole machine state, see state_hash(), 0 if nothing is loaded */
+uint64_t nes6502_state_hash(nes6502* nes)
+{
+	return nes->mch ? state_hash(nes->mch) : 0;
+}
+
+void nes6502_destroy(nes6502* nes)
+{
+	if (nes) {
+		unload(nes);
+		nes->allocator.free(nes, nes->allocator.user);
+	}
+}
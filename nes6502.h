@@ -0,0 +1,41 @@
+#ifndef NES6502_H
+#define NES6502_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+* libnes6502 - the core as a library. Each machine lives behind its own
+* handle and machines share nothing, so one process can host as many as it
+* likes. Nothing in here calls exit(), failures come back as error codes.
+*/
+
+#define NES6502_OK 0
+#define NES6502_NO_MEMORY -1
+#define NES6502_BAD_ROM -2
+#define NES6502_NOT_LOADED -3
+#define NES6502_JAMMED -4 // the cpu ran a KIL opcode
+#define NES6502_BAD_OPCODE -5 // the cpu ran an opcode the core does not implement
+
+typedef struct nes6502 nes6502;
+
+/*
+* Where a machine gets its memory from. alloc does not have to zero, user
+* is passed through untouched. A NULL allocator means malloc and free.
+*/
+typedef struct nes6502_allocator {
+	void* (*alloc)(size_t size, void* user);
+	void (*free)(void* ptr, void* user);
+	void* user;
+} nes6502_allocator;
+
+nes6502* nes6502_create(const nes6502_allocator* allocator);
+int nes6502_load(nes6502* nes, const uint8_t* rom, size_t size);
+int nes6502_reset(nes6502* nes);
+int nes6502_step(nes6502* nes);
+int nes6502_run(nes6502* nes, int64_t cycles);
+int64_t nes6502_cycles(const nes6502* nes);
+uint64_t nes6502_state_hash(nes6502* nes);
+void nes6502_destroy(nes6502* nes);
+
+#endif
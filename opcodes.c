@@ -1,1603 +1,1130 @@
+/*
+* The instruction handlers. Never compiled on its own: cpu.c includes it,
+* so it is part of the cpu core's translation unit and has no header. A
+* handler has to be defined above anything in cpu.c that calls it.
+*/
 #include <stdint.h>
 #include "io.h"
 #include "machine.h"
-
-#define SET_CARRY(x)   x | 0b00100001
-#define CLEAR_CARRY(x) x & 0b11111110
-#define SET_ZERO(x)    x | 0b00100010
-#define CLEAR_ZERO(x)  x & 0b11111101
-#define SET_OVERFLOW(x) x | 0b01100000
-#define CLEAR_OVERFLOW(x) x & 0b10111111
-#define SET_NEG(x) x | 0b10100000
-#define CLEAR_NEG(x) x & 0b01111111
-#define SET_INTERRUPT(x) x | 0b00100100
-#define CLEAR_INTERRUPT(x) x & 0b11111011
-
-/*
-* ADD with carry - Add value to dest and update flags.
-* Flags affected: S, V, Z, C
-* Cycles: 
-*/
-void adc(uint8_t value, uint8_t* dest, uint8_t* P)
-{
-	uint8_t sum = *dest + value;
-	uint8_t carry = sum ^ (*dest) ^ value;
-
-	// check for carry
-	if (carry & 0b10000000)
-		*P = SET_CARRY(*P); // set bit 0 = carry to 1
-	else
-		*P = CLEAR_CARRY(*P);
-
-	// check for zero
-	if (sum == 0b00000000)
-		*P = SET_ZERO(*P);
-	else
-		*P = CLEAR_ZERO(*P);
-
-	// check for overflow
-	if ((sum + carry) & 0b10000000)
-		*P = SET_OVERFLOW(*P);
-	else
-		*P = CLEAR_OVERFLOW(*P);
-
-	// check for negative
-	if (sum & 0b10000000)
-		SET_NEG(*P);
-	else
-		CLEAR_NEG(*P);
-
-	*dest = sum;
-}
-
-/*
-* ADD with carry for 16 bit values. Helper function that lets us set P accordingly
-* for indirect addressing.
-*/
-void adc_16(uint8_t value, uint16_t* dest, uint8_t* P)
-{
-	uint8_t sum = *dest + value;
-	uint8_t carry = sum ^ (*dest) ^ value;
-
-	// check for carry
-	if (carry & 0x800)
-		*P = SET_CARRY(*P); // set bit 0 = carry to 1
-	else
-		*P = CLEAR_CARRY(*P);
-
-	// check for zero
-	if (sum == 0x00)
-		*P = SET_ZERO(*P);
-	else
-		*P = CLEAR_ZERO(*P);
-
-	// check for overflow
-	if ((sum + carry) & 0x800)
-		*P = SET_OVERFLOW(*P);
-	else
-		*P = CLEAR_OVERFLOW(*P);
-
-	// check for negative
-	if (sum & 0b10000000)
-		SET_NEG(*P);
-	else
-		CLEAR_NEG(*P);
-
-	*dest = sum;
-}
+#include "alu.h"
+#include "cpu.h"
+#include "decode.h"
 
 
-/* page_check - helper function that checks if addr1 and 2 are on the same page
-*	returns 1 if they are on the same page
-*	returns 0 if they are on different pages
-*	returns 2 if one lies on a page boundary
-* page size = 256 bytes. => 
-*/
-char page_check(uint16_t addr1, uint16_t addr2)
-{
-	if (((uint32_t)addr1 - (uint32_t)addr2) > 0xFFFF || ((uint32_t)addr2 - (uint32_t)addr1) > 0xFFFF) {
-		return 0;
-	} else if  (((uint32_t)addr1 - (uint32_t)addr2) == -1 || ((uint32_t)addr2 - (uint32_t)addr1) == -1) {
-		return 2;
-	} else {
-		return 1;
-	}
-}
-
-void brk(machine* mch)
+static ALWAYS_INLINE void brk(cpu_core* cpu, machine* mch)
 {
 	// store pc(hi)
 	// store pc(low)
 	// store P
 	// fetch PC(low) from 0xFFFE
 	// fetch PC(hi) from 0xFFFF
-	mch->cycle += 7;
+	cpu->cycle += 7;
 }
 
-/* Return an indirect address offset by X */
-uint16_t indx_address(uint8_t top, uint8_t bot, machine* mch)
-{
-	adc(mch->X, &top, &(mch->P));
-	adc(mch->X, &bot, &(mch->P));
-	top = mch->memory[top];
-	bot = mch->memory[bot];
-	uint16_t address = (((uint16_t)top << 8) | bot);
-	return address;
-}
-
-/* Return an indirect address offset by Y */
-uint16_t indy_address(uint8_t top, uint8_t bot, machine* mch)
-{
-	top = mch->memory[top];
-	bot = mch->memory[bot];
-	uint16_t address = ((top << 8) | bot);
-	adc_16(mch->Y, &address, &(mch->P));
-	return address;
-}
 
 /* Branch - branch depending on if the value specified in bit is set. */
-void branch_set(uint8_t high, uint8_t low, machine* mch, int8_t bit)
+static ALWAYS_INLINE void branch_set(uint8_t offset, cpu_core* cpu, machine* mch, int8_t bit)
 {
-	printf("branch\n");
+	if (DEBUG) {
+		printf("branch\n");
+	}
 	// is the flag specified in "bit" set?
-	if ((mch->P & bit) != 0) {
-		// evaluate address
-		uint16_t address = (high << 8) | low;
-		if (page_check(address, mch->pc) != 1) {
-			mch->cycle += 1;
+	if ((cpu->P & bit) != 0) {
+		// the offset is signed and counts from the next instruction
+		uint16_t address = cpu->pc + (int8_t) offset;
+		if ((address & 0xFF00) != (cpu->pc & 0xFF00)) {
+			cpu->cycle += 1;
 		}
-		mch->pc = address - 1;
-		mch->cycle += 1;
+		cpu->pc = address;
+		cpu->cycle += 1;
 	}
 
-	mch->cycle += 2;
+	cpu->cycle += 2;
 }
 
 /* Branch - branch depending on if the value specified in bit is clear. */
-void branch_clear(uint8_t high, uint8_t low, machine* mch, int8_t bit)
+static ALWAYS_INLINE void branch_clear(uint8_t offset, cpu_core* cpu, machine* mch, int8_t bit)
 {
-	printf("branch\n");
+	if (DEBUG) {
+		printf("branch\n");
+	}
 	// is the flag specified in "bit" clear?
-	if ((mch->P & bit) == 0) {
-		// evaluate address
-		uint16_t address = (high << 8) | low;
-		if (page_check(address, mch->pc) != 1) {
-			mch->cycle += 1;
+	if ((cpu->P & bit) == 0) {
+		// the offset is signed and counts from the next instruction
+		uint16_t address = cpu->pc + (int8_t) offset;
+		if ((address & 0xFF00) != (cpu->pc & 0xFF00)) {
+			cpu->cycle += 1;
 		}
-		mch->pc = address - 1;
-		mch->cycle += 1;
+		cpu->pc = address;
+		cpu->cycle += 1;
 	}
 
-	mch->cycle += 2;
+	cpu->cycle += 2;
 }
 
 
 /* NOP - do nothing */
-void nop(machine* mch, uint8_t cycles)
+static ALWAYS_INLINE void nop(cpu_core* cpu, machine* mch, uint8_t cycles)
 {
-	printf("nop\n");
-	mch->cycle += cycles;
+	if (DEBUG) {
+		printf("nop\n");
+	}
+	cpu->cycle += cycles;
 }
 
 /*
-* CMP - compare value with accumulator
-* Z = 1 if value == mch, 0 otherwise
-* N = 1 if accumulator < value
-* N = 0 if accumulator > value
+* CMP - compare value with A, see compare in alu.h
+* Flags affected: N, Z, C
 */
 
 /* immediate addressing */
-void cmp_imm(uint8_t value, machine* mch)
+static ALWAYS_INLINE void cmp_imm(uint8_t value, cpu_core* cpu, machine* mch)
 {
-
-	uint8_t cmp = (mch->A)/2 - (value)/2;
-
-	if (cmp == 0) {
-		mch->P = SET_ZERO(mch->P);
-	} else if (cmp > 0) {
-		mch->P = CLEAR_ZERO(mch->P);
-		mch->P = CLEAR_NEG(mch->P);
-	} else {
-		mch->P = CLEAR_ZERO(mch->P);
-		mch->P = SET_NEG(mch->P);
-	}
-
-	mch->pc += 1;
-	mch->cycle += 2;
+	cpu->P = compare(cpu->P, cpu->A, value);
+	cpu->cycle += 2;
 }
 
-void cmp_zp(uint8_t address, machine* mch)
+static ALWAYS_INLINE void cmp_zp(uint8_t address, cpu_core* cpu, machine* mch)
 {
-	uint8_t cmp = (mch->A)/2 - (mch->memory[address])/2;
-	if (cmp == 0) {
-		mch->P = SET_ZERO(mch->P);
-	} else if (cmp > 0) {
-		mch->P = CLEAR_ZERO(mch->P);
-		mch->P = CLEAR_NEG(mch->P);
-	} else {
-		mch->P = CLEAR_ZERO(mch->P);
-		mch->P = SET_NEG(mch->P);
-	}
-
-	mch->pc += 1;
-	mch->cycle += 3;
+	cpu->P = compare(cpu->P, cpu->A, cpu_read(cpu, mch, address));
+	cpu->cycle += 3;
 }
 
-void cmp_zpx(uint8_t address, machine* mch)
+static ALWAYS_INLINE void cmp_zpx(uint8_t address, cpu_core* cpu, machine* mch)
 {
-	uint16_t adr = (uint16_t) address;
-	adc_16(mch->X, &adr, &(mch->P));
-	uint8_t cmp = (mch->A)/2 - (mch->memory[adr])/2;
-
-	if (cmp == 0) {
-		mch->P = SET_ZERO(mch->P);
-	} else if (cmp > 0) {
-		mch->P = CLEAR_ZERO(mch->P);
-		mch->P = CLEAR_NEG(mch->P);
-	} else {
-		mch->P = CLEAR_ZERO(mch->P);
-		mch->P = SET_NEG(mch->P);
-	}
-
-	mch->pc += 1;
-	mch->cycle += 4;
+	cpu->P = compare(cpu->P, cpu->A, cpu_read(cpu, mch, (uint8_t) (address + cpu->X)));
+	cpu->cycle += 4;
 }
 
-void cmp_abs(uint8_t high, uint8_t low, machine* mch, char has_offset, uint8_t offset)
+static ALWAYS_INLINE void cmp_abs(uint8_t high, uint8_t low, cpu_core* cpu, machine* mch, char has_offset, uint8_t offset)
 {
 	uint16_t adr = ((uint16_t) high << 8) | low;
 
 	if (has_offset) {
-		adc_16(offset, &adr, &mch->P);
-		if (page_check(adr, mch->pc) != 1) {
-			mch->cycle += 1;
-		}
-	}
-
-	uint8_t cmp = (mch->A)/2 - (mch->memory[adr])/2;
-
-	if (cmp == 0) {
-		mch->P = SET_ZERO(mch->P);
-	} else if (cmp > 0) {
-		mch->P = CLEAR_ZERO(mch->P);
-		mch->P = CLEAR_NEG(mch->P);
-	} else {
-		mch->P = CLEAR_ZERO(mch->P);
-		mch->P = SET_NEG(mch->P);
+		adr = indexed(cpu, adr, offset);
 	}
 
-	mch->pc += 2;
-	mch->cycle += 4;
+	cpu->P = compare(cpu->P, cpu->A, cpu_read(cpu, mch, adr));
+	cpu->cycle += 4;
 }
 
-void cmp_indx(uint8_t high, uint8_t low, machine* mch)
+static ALWAYS_INLINE void cmp_indx(uint8_t address, cpu_core* cpu, machine* mch)
 {
-	adc(mch->X, &high, &mch->P);
-	adc(mch->X, &low, &mch->P);
-	uint16_t adr = ((uint16_t)mch->memory[high] << 8) | mch->memory[low];
-	uint8_t cmp = (mch->A)/2 - (mch->memory[adr])/2;
-	if (cmp == 0) {
-		mch->P = SET_ZERO(mch->P);
-	} else if (cmp > 0) {
-		mch->P = CLEAR_ZERO(mch->P);
-		mch->P = CLEAR_NEG(mch->P);
-	} else {
-		mch->P = CLEAR_ZERO(mch->P);
-		mch->P = SET_NEG(mch->P);
-	}
-	mch->pc += 2;
-	mch->cycle += 6;
+	cpu->P = compare(cpu->P, cpu->A, cpu_read(cpu, mch, indx_address(address, cpu, mch)));
+	cpu->cycle += 6;
 }
 
-void cmp_indy(uint8_t high, uint8_t low, machine* mch)
+static ALWAYS_INLINE void cmp_indy(uint8_t address, cpu_core* cpu, machine* mch)
 {
-	uint16_t adr = ((uint16_t) mch->memory[high] << 8) | mch->memory[low];
-	adc_16(mch->Y, &adr, &mch->P);
-	if (page_check(adr, mch->pc) != 1) {
-		mch->cycle += 1;
-	}
-	uint8_t cmp = (mch->A)/2 - (mch->memory[adr])/2;
-	if (cmp == 0) {
-		mch->P = SET_ZERO(mch->P);
-	} else if (cmp > 0) {
-		mch->P = CLEAR_ZERO(mch->P);
-		mch->P = CLEAR_NEG(mch->P);
-	} else {
-		mch->P = CLEAR_ZERO(mch->P);
-		mch->P = SET_NEG(mch->P);
-	}
-	mch->pc += 2;
-	mch->cycle += 5;
+	cpu->P = compare(cpu->P, cpu->A, cpu_read(cpu, mch, indy_address(address, cpu, mch)));
+	cpu->cycle += 5;
 }
 
-/*
-* CPX - compare value with X
-* Z = 1 if value == mch, 0 otherwise
-* N = 1 if X < value
-* N = 0 if X > value
-*/
+/* CPX - compare value with X */
 
 /* immediate addressing */
-void cpx_imm(uint8_t value, machine* mch)
+static ALWAYS_INLINE void cpx_imm(uint8_t value, cpu_core* cpu, machine* mch)
 {
-	uint8_t cmp = (mch->X)/2 - (value)/2;
-
-	if (cmp == 0) {
-		mch->P = SET_ZERO(mch->P);
-	} else if (cmp > 0) {
-		mch->P = CLEAR_ZERO(mch->P);
-		mch->P = CLEAR_NEG(mch->P);
-	} else {
-		mch->P = CLEAR_ZERO(mch->P);
-		mch->P = SET_NEG(mch->P);
-	}
-
-	mch->pc += 1;
-	mch->cycle += 2;
+	cpu->P = compare(cpu->P, cpu->X, value);
+	cpu->cycle += 2;
 }
 
-void cpx_zp(uint8_t address, machine* mch)
+static ALWAYS_INLINE void cpx_zp(uint8_t address, cpu_core* cpu, machine* mch)
 {
-	uint8_t cmp = (mch->X)/2 - (mch->memory[address])/2;
-
-	if (cmp == 0) {
-		mch->P = SET_ZERO(mch->P);
-	} else if (cmp > 0) {
-		mch->P = CLEAR_ZERO(mch->P);
-		mch->P = CLEAR_NEG(mch->P);
-	} else {
-		mch->P = CLEAR_ZERO(mch->P);
-		mch->P = SET_NEG(mch->P);
-	}
-
-	mch->pc += 1;
-	mch->cycle += 3;
+	cpu->P = compare(cpu->P, cpu->X, cpu_read(cpu, mch, address));
+	cpu->cycle += 3;
 }
 
-void cpx_abs(uint8_t high, uint8_t low, machine* mch)
+static ALWAYS_INLINE void cpx_abs(uint8_t high, uint8_t low, cpu_core* cpu, machine* mch)
 {
-	uint8_t value = mch->memory[(uint16_t)(high << 8) | low];
-	uint8_t cmp = (mch->X)/2 - value/2;
-
-	if (cmp == 0) {
-		mch->P = SET_ZERO(mch->P);
-	} else if (cmp > 0) {
-		mch->P = CLEAR_ZERO(mch->P);
-		mch->P = CLEAR_NEG(mch->P);
-	} else {
-		mch->P = CLEAR_ZERO(mch->P);
-		mch->P = SET_NEG(mch->P);
-	}
-
-	mch->pc += 2;
-	mch->cycle += 4;
+	cpu->P = compare(cpu->P, cpu->X, cpu_read(cpu, mch, ((uint16_t) high << 8) | low));
+	cpu->cycle += 4;
 }
 
-/*
-* CPY - compare value with Y
-* Z = 1 if value == mch, 0 otherwise
-* N = 1 if Y < value
-* N = 0 if Y > value
-*/
+/* CPY - compare value with Y */
 
 /* immediate addressing */
-void cpy_imm(uint8_t value, machine* mch)
+static ALWAYS_INLINE void cpy_imm(uint8_t value, cpu_core* cpu, machine* mch)
 {
-	uint8_t cmp = (mch->Y)/2 - (value)/2;
-
-	if (cmp == 0) {
-		mch->P = SET_ZERO(mch->P);
-	} else if (cmp > 0) {
-		mch->P = CLEAR_ZERO(mch->P);
-		mch->P = CLEAR_NEG(mch->P);
-	} else {
-		mch->P = CLEAR_ZERO(mch->P);
-		mch->P = SET_NEG(mch->P);
-	}
-
-	mch->pc += 1;
-	mch->cycle += 2;
+	cpu->P = compare(cpu->P, cpu->Y, value);
+	cpu->cycle += 2;
 }
 
-void cpy_zp(uint8_t address, machine* mch)
+static ALWAYS_INLINE void cpy_zp(uint8_t address, cpu_core* cpu, machine* mch)
 {
-	uint8_t cmp = (mch->Y)/2 - (mch->memory[address])/2;
-
-	if (cmp == 0) {
-		mch->P = SET_ZERO(mch->P);
-	} else if (cmp > 0) {
-		mch->P = CLEAR_ZERO(mch->P);
-		mch->P = CLEAR_NEG(mch->P);
-	} else {
-		mch->P = CLEAR_ZERO(mch->P);
-		mch->P = SET_NEG(mch->P);
-	}
-
-	mch->pc += 1;
-	mch->cycle += 3;
+	cpu->P = compare(cpu->P, cpu->Y, cpu_read(cpu, mch, address));
+	cpu->cycle += 3;
 }
 
-void cpy_abs(uint8_t high, uint8_t low, machine* mch)
+static ALWAYS_INLINE void cpy_abs(uint8_t high, uint8_t low, cpu_core* cpu, machine* mch)
 {
-	uint8_t value = mch->memory[(uint16_t)(high << 8) | low];
-	uint8_t cmp = (mch->Y)/2 - value/2;
-
-	if (cmp == 0) {
-		mch->P = SET_ZERO(mch->P);
-	} else if (cmp > 0) {
-		mch->P = CLEAR_ZERO(mch->P);
-		mch->P = CLEAR_NEG(mch->P);
-	} else {
-		mch->P = CLEAR_ZERO(mch->P);
-		mch->P = SET_NEG(mch->P);
-	}
-
-	mch->pc += 2;
-	mch->cycle += 4;
+	cpu->P = compare(cpu->P, cpu->Y, cpu_read(cpu, mch, ((uint16_t) high << 8) | low));
+	cpu->cycle += 4;
 }
 
 /*
 * DEX - Decrement X
 * Flags affected - Z, N
 */
-void dex(machine* mch)
+static ALWAYS_INLINE void dex(cpu_core* cpu, machine* mch)
 {
-	uint8_t dec = mch->X - 1;
-
-	if (dec < 0)
-		mch->P = SET_NEG(mch->P);
-	else
-		mch->P = CLEAR_NEG(mch->P);
-
-	if (dec == 0)
-		mch->P = SET_ZERO(mch->P);
-	else
-		mch->P = CLEAR_ZERO(mch->P);
-
-	mch->X = dec;
-	mch->cycle += 2;
+	cpu->X = dec(cpu, cpu->X);
+	cpu->cycle += 2;
 }
 
 /*
-* DEX - Decrement Y
+* DEY - Decrement Y
 * Flags affected - Z, N
 */
-void dey(machine* mch)
+static ALWAYS_INLINE void dey(cpu_core* cpu, machine* mch)
 {
-	uint8_t dec = mch->Y - 1;
-
-	if (dec < 0)
-		mch->P = SET_NEG(mch->P);
-	else
-		mch->P = CLEAR_NEG(mch->P);
-
-	if (dec == 0)
-		mch->P = SET_ZERO(mch->P);
-	else
-		mch->P = CLEAR_ZERO(mch->P);
-
-	mch->Y = dec;
-	mch->cycle += 2;
+	cpu->Y = dec(cpu, cpu->Y);
+	cpu->cycle += 2;
 }
 
 /* CLC - clear carry */
-void clc(machine* mch)
+static ALWAYS_INLINE void clc(cpu_core* cpu, machine* mch)
 {
-	mch->P = CLEAR_CARRY(mch->P);
-	mch->cycle += 2;
+	cpu->P = CLEAR_CARRY(cpu->P);
+	cpu->cycle += 2;
 }
 
  /* CLV - clear overflow */
-void clv(machine* mch)
+static ALWAYS_INLINE void clv(cpu_core* cpu, machine* mch)
 {
-	mch->P = CLEAR_OVERFLOW(mch->P);
-	mch->cycle += 2;
+	cpu->P = CLEAR_OVERFLOW(cpu->P);
+	cpu->cycle += 2;
 }
 
 /* CLI - clear interrupt */
-void cli(machine* mch)
+static ALWAYS_INLINE void cli(cpu_core* cpu, machine* mch)
 {
-	mch->P = CLEAR_INTERRUPT(mch->P);
-	mch->cycle += 2;
+	cpu->P = CLEAR_INTERRUPT(cpu->P);
+	cpu->cycle += 2;
 }
 
-/*
-* AND - Bitwise AND with accumulator
-* Flags affected: S, Z
-*/
-void and(uint8_t value, uint8_t* A, uint8_t* P)
+/* CLD - clear decimal */
+static ALWAYS_INLINE void cld(cpu_core* cpu, machine* mch)
 {
-	uint8_t anded = *A & value;
-
-	// check if result is 0
-	if (anded == 0b00000000)
-		*P = SET_ZERO(*P);
-	else
-		*P = CLEAR_ZERO(*P);
-
-	// check if result is negative or positive
-	if (anded & 0b10000000)
-		*P = SET_NEG(*P);
-	else
-		*P = CLEAR_NEG(*P);
+	cpu->P = CLEAR_DECIMAL(cpu->P);
+	cpu->cycle += 2;
 }
 
-/* immediate addressing */
-void adc_imm(uint8_t value, machine* mch)
+
+/* ADC - add with carry, immediate addressing */
+static ALWAYS_INLINE void adc_imm(uint8_t value, cpu_core* cpu, machine* mch)
 {
-	adc(value, &(mch->A), &(mch->P));
-	mch->pc += 1;
-	mch->cycle += 2;
+	adc_a(cpu, value);
+	cpu->cycle += 2;
 }
 
 /* zero page addressing */
-void adc_zp(uint8_t address, machine* mch)
+static ALWAYS_INLINE void adc_zp(uint8_t address, cpu_core* cpu, machine* mch)
 {
-	address %= 256;
-	adc(mch->memory[address], &(mch->A), &(mch->P));
-	mch->pc += 1;
-	mch->cycle += 2;
+	adc_a(cpu, cpu_read(cpu, mch, address));
+	cpu->cycle += 3;
 }
 
-/* zero page, offset by X */
-void adc_zpx(uint8_t address, machine* mch)
+/* zero page, offset by X, wrapping within the zero page */
+static ALWAYS_INLINE void adc_zpx(uint8_t address, cpu_core* cpu, machine* mch)
 {
-	adc(mch->X, &address, &(mch->P));
-	address %= 256;
-	adc(mch->memory[address], &(mch->A), &(mch->P));
-	mch->pc += 1;
-	mch->cycle += 2;
+	adc_a(cpu, cpu_read(cpu, mch, (uint8_t) (address + cpu->X)));
+	cpu->cycle += 4;
 }
 
 /* absolute addressing */
-void adc_abs(uint8_t high, uint8_t low, machine* mch)
-{	
+static ALWAYS_INLINE void adc_abs(uint8_t high, uint8_t low, cpu_core* cpu, machine* mch)
+{
 	uint16_t address = (high << 8) | low;
-	adc(mch->memory[address], &(mch->A), &(mch->P));
-	mch->pc += 2;
-	mch->cycle += 3;
+	adc_a(cpu, cpu_read(cpu, mch, address));
+	cpu->cycle += 4;
 }
 
 /* absolute addressing, offset by the value in X */
-void adc_absx(uint8_t high, uint8_t low, machine* mch)
+static ALWAYS_INLINE void adc_absx(uint8_t high, uint8_t low, cpu_core* cpu, machine* mch)
 {
-	uint16_t address = (high << 8) | low;
-	adc_16(mch->X, &address, &(mch->P)); // add with carry X to opcode
-	adc(mch->memory[address], &(mch->A), &(mch->P));
-	mch->pc += 2;
-	mch->cycle += 3;
+	uint16_t address = indexed(cpu, (high << 8) | low, cpu->X);
+	adc_a(cpu, cpu_read(cpu, mch, address));
+	cpu->cycle += 4;
 }
 
 /* absolute addressing, offset by the value in Y */
-void adc_absy(uint8_t high, uint8_t low, machine* mch)
+static ALWAYS_INLINE void adc_absy(uint8_t high, uint8_t low, cpu_core* cpu, machine* mch)
 {
-	uint16_t address = (high << 8) | low;
-	adc_16(mch->Y, &address, &(mch->P)); // add with carry Y to opcode
-	adc(mch->memory[address], &(mch->A), &(mch->P));
-	mch->pc += 2;
-	mch->cycle += 3;
+	uint16_t address = indexed(cpu, (high << 8) | low, cpu->Y);
+	adc_a(cpu, cpu_read(cpu, mch, address));
+	cpu->cycle += 4;
 }
 
-/* indirect addressing, offset by the value of X */
-void adc_indx(uint8_t top, uint8_t bot, machine* mch)
+/* indirect through the zero page pointer at address + X */
+static ALWAYS_INLINE void adc_indx(uint8_t address, cpu_core* cpu, machine* mch)
 {
-	adc(mch->X, &top, &(mch->P));
-	adc(mch->X, &bot, &(mch->P));
-	top = mch->memory[top];
-	bot = mch->memory[bot];
-	uint16_t address = (((uint16_t)top << 8) | bot);
-	adc(mch->memory[address], &(mch->A), &(mch->P));
-	mch->pc += 2;
-	mch->cycle += 2;
+	adc_a(cpu, cpu_read(cpu, mch, indx_address(address, cpu, mch)));
+	cpu->cycle += 6;
 }
 
-/* indirect addressing, offset by the value of Y */
-void adc_indy(uint8_t top, uint8_t bot, machine* mch)
+/* indirect through the zero page pointer at address, offset by Y */
+static ALWAYS_INLINE void adc_indy(uint8_t address, cpu_core* cpu, machine* mch)
 {
-	top = mch->memory[top];
-	bot = mch->memory[bot];
-	uint16_t address = ((top << 8) | bot);
-	adc_16(mch->Y, &address, &(mch->P));
-	adc(mch->memory[address], &(mch->A), &(mch->P));
-	mch->pc += 2;
-	mch->cycle += 2;
+	adc_a(cpu, cpu_read(cpu, mch, indy_address(address, cpu, mch)));
+	cpu->cycle += 5;
 }
 
-/* immediate addressing */
-void and_imm(uint8_t value, machine* mch)
+/* SBC - subtract with borrow, immediate addressing */
+static ALWAYS_INLINE void sbc_imm(uint8_t value, cpu_core* cpu, machine* mch)
 {
-	and(value, &(mch->A), &(mch->P));
-	mch->pc += 1;
-	mch->cycle += 2;
+	sbc_a(cpu, value);
+	cpu->cycle += 2;
 }
 
-/* zero page */
-void and_zp(uint8_t address, machine* mch)
+/* zero page addressing */
+static ALWAYS_INLINE void sbc_zp(uint8_t address, cpu_core* cpu, machine* mch)
 {
-	and(mch->memory[address%256], &(mch->A), &(mch->P));
-	mch->cycle += 3;
-	mch->pc += 1;
+	sbc_a(cpu, cpu_read(cpu, mch, address));
+	cpu->cycle += 3;
 }
 
-/* zero page offset by x */
-void and_zpx(uint8_t address, machine* mch)
+/* zero page, offset by X, wrapping within the zero page */
+static ALWAYS_INLINE void sbc_zpx(uint8_t address, cpu_core* cpu, machine* mch)
 {
-	adc(mch->X, &address, &(mch->P));
-	address %= 256;
-	and(mch->memory[address], &(mch->A), &(mch->P));
-	mch->cycle += 4;
-	mch->pc += 1;
+	sbc_a(cpu, cpu_read(cpu, mch, (uint8_t) (address + cpu->X)));
+	cpu->cycle += 4;
 }
 
-/* absolute */
-void and_abs(uint8_t high, uint8_t low, machine* mch)
+/* absolute addressing */
+static ALWAYS_INLINE void sbc_abs(uint8_t high, uint8_t low, cpu_core* cpu, machine* mch)
 {
 	uint16_t address = (high << 8) | low;
-	and(mch->memory[address], &(mch->A), &(mch->P));
-	mch->pc += 2;
-	mch->cycle += 4;
+	sbc_a(cpu, cpu_read(cpu, mch, address));
+	cpu->cycle += 4;
 }
 
-/* absolute offset by x */
-void and_absx(uint8_t high, uint8_t low, machine* mch)
+/* absolute addressing, offset by the value in X */
+static ALWAYS_INLINE void sbc_absx(uint8_t high, uint8_t low, cpu_core* cpu, machine* mch)
 {
-	uint16_t address = (high << 8) | low;
-	adc_16(mch->X, &address, &(mch->P));
-	and(mch->memory[address], &(mch->A), &(mch->P));
-
-	if (page_check(address, mch->pc) != 1) {
-		mch->cycle += 1;
-	}
-
-	mch->pc += 2;
-	mch->cycle += 4;
+	uint16_t address = indexed(cpu, (high << 8) | low, cpu->X);
+	sbc_a(cpu, cpu_read(cpu, mch, address));
+	cpu->cycle += 4;
 }
 
-/* absolute offest by y */
-void and_absy(uint8_t high, uint8_t low, machine* mch)
+/* absolute addressing, offset by the value in Y */
+static ALWAYS_INLINE void sbc_absy(uint8_t high, uint8_t low, cpu_core* cpu, machine* mch)
 {
-	uint16_t address = (high << 8) | low;
-	adc_16(mch->Y, &address, &(mch->P));
-	and(mch->memory[address], &(mch->A), &(mch->P));
-
-	if (page_check(address, mch->pc) != 1) {
-		mch->cycle += 1;
-	}
-
-	mch->pc += 2;
-	mch->cycle += 4;
+	uint16_t address = indexed(cpu, (high << 8) | low, cpu->Y);
+	sbc_a(cpu, cpu_read(cpu, mch, address));
+	cpu->cycle += 4;
 }
 
-/* indirect offset by x */
-void and_indx(uint8_t top, uint8_t bot, machine* mch)
+/* indirect through the zero page pointer at address + X */
+static ALWAYS_INLINE void sbc_indx(uint8_t address, cpu_core* cpu, machine* mch)
 {
-	adc(mch->X, &top, &(mch->P));
-	adc(mch->X, &bot, &(mch->P));
-	top = mch->memory[top];
-	bot = mch->memory[bot];
-	uint16_t address = (((uint16_t)top << 8) | bot);
-	and(mch->memory[address], &(mch->A), &(mch->P));
-	mch->pc += 2;
-	mch->cycle += 6;
+	sbc_a(cpu, cpu_read(cpu, mch, indx_address(address, cpu, mch)));
+	cpu->cycle += 6;
 }
 
-/* indirect offset by y*/
-void and_indy(uint8_t top, uint8_t bot, machine* mch)
+/* indirect through the zero page pointer at address, offset by Y */
+static ALWAYS_INLINE void sbc_indy(uint8_t address, cpu_core* cpu, machine* mch)
 {
-	top = mch->memory[top];
-	bot = mch->memory[bot];
-	uint16_t address = (((uint16_t)top << 8) | bot);
-	adc_16(mch->Y, &address, &(mch->P));
-	and(mch->memory[address], &(mch->A), &(mch->P));
-
-	if (page_check(address, mch->pc) != 1) {
-		mch->cycle += 1;
-	}
-
-	mch->pc += 2;
-	mch->cycle += 5;
+	sbc_a(cpu, cpu_read(cpu, mch, indy_address(address, cpu, mch)));
+	cpu->cycle += 5;
 }
 
-/* EOR - Bitwise XOR with accumulator.
-* Flags: Z, S
-*/
-
-void eor(uint8_t value, machine* mch)
+/* AND - bitwise and with A, immediate addressing */
+static ALWAYS_INLINE void and_imm(uint8_t value, cpu_core* cpu, machine* mch)
 {
-	uint8_t xored = value ^ mch->A;
-
-	if (xored == 0)
-		mch->P = SET_ZERO(mch->P);
-	else
-		mch->P = CLEAR_ZERO(mch->P);
-
-	if (xored < 0)
-		mch->P = SET_NEG(mch->P);
-	else
-		mch->P = CLEAR_NEG(mch->P);
+	and(cpu, value);
+	cpu->cycle += 2;
 }
 
-void eor_imm(uint8_t value, machine* mch)
+/* zero page addressing */
+static ALWAYS_INLINE void and_zp(uint8_t address, cpu_core* cpu, machine* mch)
 {
-	eor(value, mch);
-	mch->cycle += 2;
-	mch->pc += 1;
+	and(cpu, cpu_read(cpu, mch, address));
+	cpu->cycle += 3;
 }
 
-void eor_zp(uint8_t value, machine* mch)
+/* zero page, offset by X, wrapping within the zero page */
+static ALWAYS_INLINE void and_zpx(uint8_t address, cpu_core* cpu, machine* mch)
 {
-	eor(mch->memory[value], mch);
-	mch->cycle += 3;
-	mch->pc += 1;
+	and(cpu, cpu_read(cpu, mch, (uint8_t) (address + cpu->X)));
+	cpu->cycle += 4;
 }
 
-void eor_zpx(uint8_t value, machine* mch)
+/* absolute addressing */
+static ALWAYS_INLINE void and_abs(uint8_t high, uint8_t low, cpu_core* cpu, machine* mch)
 {
-	value += mch->X;
-	value %= 256;
-	eor(mch->memory[value], mch);
-	mch->cycle += 4;
-	mch->pc += 1;
+	uint16_t address = (high << 8) | low;
+	and(cpu, cpu_read(cpu, mch, address));
+	cpu->cycle += 4;
 }
 
-void eor_abs(uint8_t top, uint8_t bot, machine* mch)
+/* absolute addressing, offset by the value in X */
+static ALWAYS_INLINE void and_absx(uint8_t high, uint8_t low, cpu_core* cpu, machine* mch)
 {
-	eor(mch->memory[((uint16_t) top << 8) | bot], mch);
-	mch->cycle += 4;
-	mch->pc += 2;
+	uint16_t address = indexed(cpu, (high << 8) | low, cpu->X);
+	and(cpu, cpu_read(cpu, mch, address));
+	cpu->cycle += 4;
 }
 
-void eor_absx(uint8_t top, uint8_t bot, machine* mch)
+/* absolute addressing, offset by the value in Y */
+static ALWAYS_INLINE void and_absy(uint8_t high, uint8_t low, cpu_core* cpu, machine* mch)
 {
-	uint16_t adr = ((uint16_t)top << 8) | bot;
-	adc_16(mch->X, &adr, &(mch->P));
-	eor(mch->memory[adr], mch);
-	if (page_check(adr, mch->pc) != 1)
-		mch->cycle += 1;
-	mch->cycle += 4;
-	mch->pc += 2;
+	uint16_t address = indexed(cpu, (high << 8) | low, cpu->Y);
+	and(cpu, cpu_read(cpu, mch, address));
+	cpu->cycle += 4;
 }
 
-void eor_absy(uint8_t top, uint8_t bot, machine* mch)
+/* indirect through the zero page pointer at address + X */
+static ALWAYS_INLINE void and_indx(uint8_t address, cpu_core* cpu, machine* mch)
 {
-	uint16_t adr = ((uint16_t)top << 8) | bot;
-	adc_16(mch->Y, &adr, &(mch->P));
-	eor(mch->memory[adr], mch);
-	if (page_check(adr, mch->pc) != 1)
-		mch->cycle += 1;
-	mch->cycle += 4;
-	mch->pc += 2;
+	and(cpu, cpu_read(cpu, mch, indx_address(address, cpu, mch)));
+	cpu->cycle += 6;
 }
 
-void eor_indx(uint8_t top, uint8_t bot, machine* mch)
+/* indirect through the zero page pointer at address, offset by Y */
+static ALWAYS_INLINE void and_indy(uint8_t address, cpu_core* cpu, machine* mch)
 {
-	adc(mch->X, &top, &(mch->P));
-	adc(mch->X, &bot, &(mch->P));
-	top = mch->memory[top];
-	bot = mch->memory[bot];
-	uint16_t adr = ((uint16_t)top << 8) | bot;
-	eor(mch->memory[adr], mch);
-	mch->cycle += 6;
-	mch->pc += 2;
+	and(cpu, cpu_read(cpu, mch, indy_address(address, cpu, mch)));
+	cpu->cycle += 5;
 }
 
-void eor_indy(uint8_t top, uint8_t bot, machine* mch)
+/* EOR - bitwise exclusive or with A, immediate addressing */
+static ALWAYS_INLINE void eor_imm(uint8_t value, cpu_core* cpu, machine* mch)
 {
-	top = mch->memory[top];
-	bot = mch->memory[bot];
-	uint16_t adr = ((uint16_t) top << 8) | bot;
-	adc_16(mch->Y, &adr, &mch->P);
-	eor(mch->memory[adr], mch);
-	if (page_check(adr, mch->pc) != 1)
-		mch->cycle += 1;
-	mch->cycle += 5;
+	eor(cpu, value);
+	cpu->cycle += 2;
 }
 
-/*
-* ORA - Bitwise OR with accumulator
-* Flags affected: S, Z
-*/
-void or(uint8_t value, uint8_t* A, uint8_t* P)
+/* zero page addressing */
+static ALWAYS_INLINE void eor_zp(uint8_t address, cpu_core* cpu, machine* mch)
 {
-	uint8_t ored = *A | value;
+	eor(cpu, cpu_read(cpu, mch, address));
+	cpu->cycle += 3;
+}
 
-	// check if result is 0
-	if (ored == 0b00000000)
-		*P = SET_ZERO(*P);
-	else
-		*P = CLEAR_ZERO(*P);
+/* zero page, offset by X, wrapping within the zero page */
+static ALWAYS_INLINE void eor_zpx(uint8_t address, cpu_core* cpu, machine* mch)
+{
+	eor(cpu, cpu_read(cpu, mch, (uint8_t) (address + cpu->X)));
+	cpu->cycle += 4;
+}
 
-	// check if result is negative or positive
-	if (ored & 0b10000000)
-		*P = SET_NEG(*P);
-	else
-		*P = CLEAR_NEG(*P);
+/* absolute addressing */
+static ALWAYS_INLINE void eor_abs(uint8_t high, uint8_t low, cpu_core* cpu, machine* mch)
+{
+	uint16_t address = (high << 8) | low;
+	eor(cpu, cpu_read(cpu, mch, address));
+	cpu->cycle += 4;
 }
 
-/* immediate addressing */
-void or_imm(uint8_t value, machine* mch)
+/* absolute addressing, offset by the value in X */
+static ALWAYS_INLINE void eor_absx(uint8_t high, uint8_t low, cpu_core* cpu, machine* mch)
 {
-	or(value, &(mch->A), &(mch->P));
-	mch->pc += 1;
-	mch->cycle += 2;
+	uint16_t address = indexed(cpu, (high << 8) | low, cpu->X);
+	eor(cpu, cpu_read(cpu, mch, address));
+	cpu->cycle += 4;
 }
 
-/* zero page */
-void or_zp(uint8_t address, machine* mch)
+/* absolute addressing, offset by the value in Y */
+static ALWAYS_INLINE void eor_absy(uint8_t high, uint8_t low, cpu_core* cpu, machine* mch)
 {
-	or(mch->memory[address%256], &(mch->A), &(mch->P));
-	mch->cycle += 3;
-	mch->pc += 1;
+	uint16_t address = indexed(cpu, (high << 8) | low, cpu->Y);
+	eor(cpu, cpu_read(cpu, mch, address));
+	cpu->cycle += 4;
 }
 
-/* zero page offset by x */
-void or_zpx(uint8_t address, machine* mch)
+/* indirect through the zero page pointer at address + X */
+static ALWAYS_INLINE void eor_indx(uint8_t address, cpu_core* cpu, machine* mch)
 {
-	adc(mch->X, &address, &(mch->P));
-	address %= 256;
-	or(mch->memory[address], &(mch->A), &(mch->P));
-	mch->cycle += 4;
-	mch->pc += 1;
+	eor(cpu, cpu_read(cpu, mch, indx_address(address, cpu, mch)));
+	cpu->cycle += 6;
 }
 
-/* absolute */
-void or_abs(uint8_t high, uint8_t low, machine* mch)
+/* indirect through the zero page pointer at address, offset by Y */
+static ALWAYS_INLINE void eor_indy(uint8_t address, cpu_core* cpu, machine* mch)
 {
-	uint16_t address = (high << 8) | low;
-	or(mch->memory[address], &(mch->A), &(mch->P));
-	mch->pc += 2;
-	mch->cycle += 4;
+	eor(cpu, cpu_read(cpu, mch, indy_address(address, cpu, mch)));
+	cpu->cycle += 5;
 }
 
-/* absolute offset by x */
-void or_absx(uint8_t high, uint8_t low, machine* mch)
+/* ORA - bitwise or with A, immediate addressing */
+static ALWAYS_INLINE void or_imm(uint8_t value, cpu_core* cpu, machine* mch)
 {
-	uint16_t address = (high << 8) | low;
-	adc_16(mch->X, &address, &(mch->P));
-	or(mch->memory[address], &(mch->A), &(mch->P));
+	or(cpu, value);
+	cpu->cycle += 2;
+}
 
-	if (page_check(address, mch->pc) != 1) {
-		mch->cycle += 1;
-	}
+/* zero page addressing */
+static ALWAYS_INLINE void or_zp(uint8_t address, cpu_core* cpu, machine* mch)
+{
+	or(cpu, cpu_read(cpu, mch, address));
+	cpu->cycle += 3;
+}
 
-	mch->pc += 2;
-	mch->cycle += 4;
+/* zero page, offset by X, wrapping within the zero page */
+static ALWAYS_INLINE void or_zpx(uint8_t address, cpu_core* cpu, machine* mch)
+{
+	or(cpu, cpu_read(cpu, mch, (uint8_t) (address + cpu->X)));
+	cpu->cycle += 4;
 }
 
-/* absolute offest by y */
-void or_absy(uint8_t high, uint8_t low, machine* mch)
+/* absolute addressing */
+static ALWAYS_INLINE void or_abs(uint8_t high, uint8_t low, cpu_core* cpu, machine* mch)
 {
 	uint16_t address = (high << 8) | low;
-	adc_16(mch->Y, &address, &(mch->P));
-	or(mch->memory[address], &(mch->A), &(mch->P));
-
-	if (page_check(address, mch->pc) != 1) {
-		mch->cycle += 1;
-	}
-
-	mch->pc += 2;
-	mch->cycle += 4;
+	or(cpu, cpu_read(cpu, mch, address));
+	cpu->cycle += 4;
 }
 
-/* indirect offset by x */
-void or_indx(uint8_t top, uint8_t bot, machine* mch)
+/* absolute addressing, offset by the value in X */
+static ALWAYS_INLINE void or_absx(uint8_t high, uint8_t low, cpu_core* cpu, machine* mch)
 {
-	adc(mch->X, &top, &(mch->P));
-	adc(mch->X, &bot, &(mch->P));
-	top = mch->memory[top];
-	bot = mch->memory[bot];
-	uint16_t address = (((uint16_t)top << 8) | bot);
-	or(mch->memory[address], &(mch->A), &(mch->P));
-	mch->pc += 2;
-	mch->cycle += 6;
+	uint16_t address = indexed(cpu, (high << 8) | low, cpu->X);
+	or(cpu, cpu_read(cpu, mch, address));
+	cpu->cycle += 4;
 }
 
-/* indirect offset by y*/
-void or_indy(uint8_t top, uint8_t bot, machine* mch)
+/* absolute addressing, offset by the value in Y */
+static ALWAYS_INLINE void or_absy(uint8_t high, uint8_t low, cpu_core* cpu, machine* mch)
 {
-	top = mch->memory[top];
-	bot = mch->memory[bot];
-	uint16_t address = (((uint16_t)top << 8) | bot);
-	adc_16(mch->Y, &address, &(mch->P));
-	or(mch->memory[address], &(mch->A), &(mch->P));
-
-	if (page_check(address, mch->pc) != 1) {
-		mch->cycle += 1;
-	}
-
-	mch->pc += 2;
-	mch->cycle += 5;
+	uint16_t address = indexed(cpu, (high << 8) | low, cpu->Y);
+	or(cpu, cpu_read(cpu, mch, address));
+	cpu->cycle += 4;
 }
 
-
-/*
-* ASL - Arithmetic shift left dest by one bit
-* Flags affected: N, Z, C
-*/
-void asl(uint8_t* dest, uint8_t* P)
+/* indirect through the zero page pointer at address + X */
+static ALWAYS_INLINE void or_indx(uint8_t address, cpu_core* cpu, machine* mch)
 {
-	// negative left shifts aren't defined in C
-	if (*dest >= 0) {
-		*dest <<= 1;
-	} else {
-		*dest <<= 1;
-		*dest |= 0b10000000;
-	}
-
-	// set the zero flag
-	if (*dest == 0)
-		*P = SET_ZERO(*P);
-	else
-		*P = CLEAR_ZERO(*P);
-
-	// set the carry flag
-	if ((0b00000001 << 1) == 0)
-		*P = SET_CARRY(*P);
-	else
-		*P = CLEAR_CARRY(*P);
-
-	// set the neg flag
-	if (*dest < 0)
-		*P = SET_NEG(*P);
-	else
-		*P = CLEAR_NEG(*P);
+	or(cpu, cpu_read(cpu, mch, indx_address(address, cpu, mch)));
+	cpu->cycle += 6;
 }
 
-void asl_acc(machine* mch)
+/* indirect through the zero page pointer at address, offset by Y */
+static ALWAYS_INLINE void or_indy(uint8_t address, cpu_core* cpu, machine* mch)
 {
-	asl(&(mch->A), &(mch->P));
-	mch->cycle += 2;
+	or(cpu, cpu_read(cpu, mch, indy_address(address, cpu, mch)));
+	cpu->cycle += 5;
 }
 
-void asl_zp(uint8_t address, machine* mch)
-{	
-	asl(&(mch->memory[address]), &(mch->P));
-	mch->pc += 1;
-	mch->cycle += 5;
+
+/* ASL - shift left, on the accumulator */
+static ALWAYS_INLINE void asl_acc(cpu_core* cpu, machine* mch)
+{
+	cpu->A = asl(cpu, cpu->A);
+	cpu->cycle += 2;
 }
 
-void asl_zpx(uint8_t address, machine* mch)
-{	
-	uint16_t adr = address;
-	adc_16(mch->X, &adr, &(mch->P));
-	asl(&(mch->memory[adr]), &(mch->P));
-	mch->pc += 1;
-	mch->cycle += 6;
+static ALWAYS_INLINE void asl_zp(uint8_t address, cpu_core* cpu, machine* mch)
+{
+	cpu_write(cpu, mch, address, asl(cpu, cpu_read(cpu, mch, address)));
+	cpu->cycle += 5;
 }
 
-void asl_abs(uint8_t top, uint8_t bot, machine* mch)
-{	
-	uint16_t address = ((uint16_t) mch->memory[top] << 8) | mch->memory[bot];
-	asl(&(mch->memory[address]), &(mch->P));
-	mch->pc += 2;
-	mch->cycle += 6;
+static ALWAYS_INLINE void asl_zpx(uint8_t address, cpu_core* cpu, machine* mch)
+{
+	uint8_t adr = address + cpu->X;
+	cpu_write(cpu, mch, adr, asl(cpu, cpu_read(cpu, mch, adr)));
+	cpu->cycle += 6;
 }
 
-void asl_absx(uint8_t high, uint8_t low, machine* mch)
+static ALWAYS_INLINE void asl_abs(uint8_t high, uint8_t low, cpu_core* cpu, machine* mch)
 {
 	uint16_t address = (high << 8) | low;
-	adc_16(mch->X, &address, &(mch->P));
-	asl(&(mch->memory[address]), &(mch->P));
-	mch->pc += 2;
-	mch->cycle += 7;
+	cpu_write(cpu, mch, address, asl(cpu, cpu_read(cpu, mch, address)));
+	cpu->cycle += 6;
 }
 
-/*
-* LSR - Logical shift right
-* Flags affected: carry flag becomes what was in bit 0, bit 7 set to 0 
-*/
-void lsr(uint8_t* dest, uint8_t* P)
+/* read-modify-write always takes the extra cycle, page crossed or not */
+static ALWAYS_INLINE void asl_absx(uint8_t high, uint8_t low, cpu_core* cpu, machine* mch)
 {
-	if ((*dest & 0b00000001) == 0) {
-		*P = CLEAR_CARRY(*P);
-	} else {
-		*P = SET_CARRY(*P);
-	}
-
-	*dest >>= 1;
-	*dest &= 0b01111111;
-
+	uint16_t address = ((high << 8) | low) + cpu->X;
+	cpu_write(cpu, mch, address, asl(cpu, cpu_read(cpu, mch, address)));
+	cpu->cycle += 7;
 }
 
-void lsr_acc(machine* mch)
+
+/* LSR - shift right, on the accumulator */
+static ALWAYS_INLINE void lsr_acc(cpu_core* cpu, machine* mch)
 {
-	lsr(&(mch->A), &(mch->P));
-	mch->cycle += 2;
+	cpu->A = lsr(cpu, cpu->A);
+	cpu->cycle += 2;
 }
 
-void lsr_zp(uint8_t address, machine* mch)
+static ALWAYS_INLINE void lsr_zp(uint8_t address, cpu_core* cpu, machine* mch)
 {
-	lsr(&(mch->memory[address]), &(mch->P));
-	mch->cycle += 5;
-	mch->pc += 1;
+	cpu_write(cpu, mch, address, lsr(cpu, cpu_read(cpu, mch, address)));
+	cpu->cycle += 5;
 }
 
-void lsr_zpx(uint8_t address, machine* mch)
+static ALWAYS_INLINE void lsr_zpx(uint8_t address, cpu_core* cpu, machine* mch)
 {
-	uint16_t adr = (uint16_t) address;
-	adc_16(mch->X, &adr, &(mch->P));
-	lsr(&(mch->memory[address]), &(mch->P));
-	mch->cycle += 6;
-	mch->pc += 1;
+	uint8_t adr = address + cpu->X;
+	cpu_write(cpu, mch, adr, lsr(cpu, cpu_read(cpu, mch, adr)));
+	cpu->cycle += 6;
 }
 
-void lsr_abs(uint8_t top, uint8_t bot, machine* mch)
+static ALWAYS_INLINE void lsr_abs(uint8_t high, uint8_t low, cpu_core* cpu, machine* mch)
 {
-	uint16_t adr = ((uint16_t) top << 8) | bot;
-	lsr(&(mch->memory[adr]), &(mch->P));
-	mch->cycle += 6;
-	mch->pc += 2;
+	uint16_t address = (high << 8) | low;
+	cpu_write(cpu, mch, address, lsr(cpu, cpu_read(cpu, mch, address)));
+	cpu->cycle += 6;
 }
 
-void lsr_absx(uint8_t top, uint8_t bot, machine* mch)
+/* read-modify-write always takes the extra cycle, page crossed or not */
+static ALWAYS_INLINE void lsr_absx(uint8_t high, uint8_t low, cpu_core* cpu, machine* mch)
 {
-	uint16_t adr = ((uint16_t) top << 8) | bot;
-	adc_16(mch->X, &adr, &(mch->P));
-	lsr(&(mch->memory[adr]), &(mch->P));
-	mch->cycle += 7;
-	mch->pc += 2;
+	uint16_t address = ((high << 8) | low) + cpu->X;
+	cpu_write(cpu, mch, address, lsr(cpu, cpu_read(cpu, mch, address)));
+	cpu->cycle += 7;
 }
 
 /* JMP - set PC to given address */
-void jmp(uint8_t high, uint8_t low, machine* mch)
+static ALWAYS_INLINE void jmp(uint8_t high, uint8_t low, cpu_core* cpu, machine* mch)
 {
 	uint16_t address = (high << 8) | low;
-	mch->pc = address-1;
-	mch->cycle += 3;
+	cpu->pc = address;
+	cpu->cycle += 3;
 }
 
 /* INY - increment Y */
-void iny(machine* mch)
+static ALWAYS_INLINE void iny(cpu_core* cpu, machine* mch)
 {
-	adc(1, &mch->Y, &mch->P);
-	mch->cycle += 2;
+	cpu->Y = inc(cpu, cpu->Y);
+	cpu->cycle += 2;
 }
 
-/* INY - increment X */
-void inx(machine* mch)
+/* INX - increment X */
+static ALWAYS_INLINE void inx(cpu_core* cpu, machine* mch)
 {
-	adc(1, &mch->X, &mch->P);
-	mch->cycle += 2;
+	cpu->X = inc(cpu, cpu->X);
+	cpu->cycle += 2;
 }
 
-void inc_zp(uint8_t address, machine* mch, char has_offset, uint8_t offset)
+/* INC - increment memory, zero page or zero page offset by X */
+static ALWAYS_INLINE void inc_zp(uint8_t address, cpu_core* cpu, machine* mch, char has_offset, uint8_t offset)
 {
-	if (has_offset) {
-		adc(mch->X, &address, &mch->P);
-		mch->cycle += 1;
-	}
-	adc(1, &mch->memory[address], &mch->P);
-	mch->cycle += 3;
+	uint8_t adr = address + offset;
+	cpu_write(cpu, mch, adr, inc(cpu, cpu_read(cpu, mch, adr)));
+	cpu->cycle += 5 + has_offset;
 }
 
-void inc_abs(uint8_t high, uint8_t low, machine* mch, char has_offset, uint8_t offset)
+/* absolute or absolute offset by X, which always takes the extra cycle */
+static ALWAYS_INLINE void inc_abs(uint8_t high, uint8_t low, cpu_core* cpu, machine* mch, char has_offset, uint8_t offset)
 {
-	uint16_t address = ((uint16_t)high << 8) | low;
-	if (has_offset) {
-		address += mch->X;
-		if (page_check(address, mch->pc) != 1) {
-			mch->cycle += 1;
-		}
-	}
-
-	adc(1, &mch->memory[address], &mch->P);
-	mch->cycle += 4;
+	uint16_t address = (((uint16_t) high << 8) | low) + offset;
+	cpu_write(cpu, mch, address, inc(cpu, cpu_read(cpu, mch, address)));
+	cpu->cycle += 6 + has_offset;
 }
 
 /* JMP - set PC to given address */
-void jmp_abs(uint8_t high, uint8_t low, machine* mch)
+static ALWAYS_INLINE void jmp_abs(uint8_t high, uint8_t low, cpu_core* cpu, machine* mch)
 {
 	uint16_t address = (high << 8) | low;
-	mch->pc = address-1;
-	mch->cycle += 3;
+	cpu->pc = address;
+	cpu->cycle += 3;
 }
 
-void jmp_ind(uint8_t high, uint8_t low, machine* mch)
+static ALWAYS_INLINE void jmp_ind(uint8_t high, uint8_t low, cpu_core* cpu, machine* mch)
 {
-	uint16_t address = (mch->memory[high] << 8) | mch->memory[low];
-	mch->pc = address-1;
-	mch->cycle += 5;
+	uint16_t pointer = (high << 8) | low;
+#if CPU_VARIANT == CPU_65C02
+	// fixed on the 65C02, at the cost of a cycle
+	uint16_t address = cpu_read(cpu, mch, pointer) | (cpu_read(cpu, mch, pointer + 1) << 8);
+	cpu->cycle += 1;
+#else
+	// the high byte comes from the same page, the 6502 does not carry into it
+	uint16_t address = cpu_read(cpu, mch, pointer) | (cpu_read(cpu, mch, (pointer & 0xFF00) | ((pointer + 1) & 0x00FF)) << 8);
+#endif
+	cpu->pc = address;
+	cpu->cycle += 5;
 }
 
-/* BIT - check if the bits in A are set in the value at some memory address
-* Only impacts zero flag. Does not store a result. 
-*/
-void bit(uint8_t pattern, uint8_t value, uint8_t* P)
-{
-	// one or more bits set?
-	if ((pattern & value) != 0) {
-		*P = CLEAR_ZERO(*P);
-	} else {
-		*P = SET_ZERO(*P);
-	}
 
-}
-
-void bit_zp(uint8_t pat_adr, machine* mch)
+/* BIT - test A against memory, see bit in alu.h */
+static ALWAYS_INLINE void bit_zp(uint8_t address, cpu_core* cpu, machine* mch)
 {
-	bit(mch->A, mch->memory[pat_adr], &(mch->P));
-	mch->cycle += 3;
-	mch->pc += 1;
+	bit(cpu, cpu_read(cpu, mch, address));
+	cpu->cycle += 3;
 }
 
-void bit_abs(uint8_t top, uint8_t bot, machine* mch)
+static ALWAYS_INLINE void bit_abs(uint8_t high, uint8_t low, cpu_core* cpu, machine* mch)
 {
-	uint16_t adr = ((uint16_t)top << 8) | bot;
-	bit(mch->A, mch->memory[adr], &(mch->P));
-	mch->cycle += 4;
-	mch->pc += 2;
+	bit(cpu, cpu_read(cpu, mch, ((uint16_t) high << 8) | low));
+	cpu->cycle += 4;
 }
 
-/* DEC - decrement value at specified memory location by 1
-* Impacts zero and negative flags
-*/
-
-void dec(uint8_t* value, uint8_t* P)
+/* DEC - decrement memory */
+static ALWAYS_INLINE void dec_zp(uint8_t address, cpu_core* cpu, machine* mch)
 {
-	*value -= 1;
-	if (*value == 0) {
-		*P = SET_ZERO(*P);
-	}
-
-	if (*value < 0) {
-		*P = SET_NEG(*P);
-	}
+	cpu_write(cpu, mch, address, dec(cpu, cpu_read(cpu, mch, address)));
+	cpu->cycle += 5;
 }
 
-void dec_zp(uint8_t address, machine* mch)
-{	
-	dec(&(mch->memory[address]), &(mch->P));
-	mch->cycle += 5;
-	mch->pc += 1;
+static ALWAYS_INLINE void dec_zpx(uint8_t address, cpu_core* cpu, machine* mch)
+{
+	uint8_t adr = address + cpu->X;
+	cpu_write(cpu, mch, adr, dec(cpu, cpu_read(cpu, mch, adr)));
+	cpu->cycle += 6;
 }
 
-void dec_zpx(uint8_t address, machine* mch)
-{	
-	uint16_t adr = (uint16_t) address;
-	adc_16(mch->X, &adr, &(mch->P));
-	dec(&(mch->memory[adr]), &(mch->P));
-	mch->cycle += 6;
-	mch->pc += 1;
+static ALWAYS_INLINE void dec_abs(uint8_t high, uint8_t low, cpu_core* cpu, machine* mch)
+{
+	uint16_t address = ((uint16_t) high << 8) | low;
+	cpu_write(cpu, mch, address, dec(cpu, cpu_read(cpu, mch, address)));
+	cpu->cycle += 6;
 }
 
-void dec_abs(uint8_t top, uint8_t bot, machine* mch)
-{	
-	uint16_t adr = ((uint16_t) top << 8) | bot;
-	dec(&(mch->memory[adr]), &(mch->P));
-	mch->cycle += 6;
-	mch->pc += 2;
+static ALWAYS_INLINE void dec_absx(uint8_t high, uint8_t low, cpu_core* cpu, machine* mch)
+{
+	uint16_t address = (((uint16_t) high << 8) | low) + cpu->X;
+	cpu_write(cpu, mch, address, dec(cpu, cpu_read(cpu, mch, address)));
+	cpu->cycle += 7;
 }
 
-void dec_absx(uint8_t top, uint8_t bot, machine* mch)
-{	
-	uint16_t adr = ((uint16_t) top << 8) | bot;
-	adc_16(mch->X, &adr, &(mch->P));
-	dec(&(mch->memory[adr]), &(mch->P));
-	mch->cycle += 7;
-	mch->pc += 2;
+/* LDA - load A, immediate addressing */
+static ALWAYS_INLINE void lda_imm(uint8_t value, cpu_core* cpu, machine* mch)
+{
+	cpu->A = load(cpu, value);
+	cpu->cycle += 2;
 }
 
-void lda_imm(uint8_t adr, machine* mch)
+/* absolute, or absolute offset by X or Y */
+static ALWAYS_INLINE void lda_abs(uint8_t high, uint8_t low, cpu_core* cpu, machine* mch, char has_offset, uint8_t offset)
 {
-	if (adr == 0) {
-		mch->P = SET_ZERO(mch->P); 
-	} else {
-		mch->P = CLEAR_ZERO(mch->P);
-	}
+	uint16_t adr = ((uint16_t) high << 8) | low;
 
-	if (adr < 0) {
-		mch->P = SET_NEG(mch->P);
-	} else {
-		mch->P = CLEAR_NEG(mch->P);
+	if (has_offset) {
+		adr = indexed(cpu, adr, offset);
 	}
 
-	mch->A = mch->memory[adr];
-	mch->cycle += 2;
-	mch->pc += 1;
+	cpu->A = load(cpu, cpu_read(cpu, mch, adr));
+	cpu->cycle += 4;
 }
 
-
-void lda_abs(uint8_t top, uint8_t bot, machine* mch, char has_offset, uint8_t offset)
+/* zero page, or zero page offset by X, wrapping within the zero page */
+static ALWAYS_INLINE void lda_zp(uint8_t address, cpu_core* cpu, machine* mch, char has_offset, uint8_t offset)
 {
-	uint16_t adr = ((uint16_t) top << 8) | bot;
+	cpu->A = load(cpu, cpu_read(cpu, mch, (uint8_t) (address + offset)));
+	cpu->cycle += 3 + has_offset;
+}
 
-	if (has_offset) {
-		adr += offset;
-		if (page_check(adr, mch->pc) != 1) {
-			mch->cycle += 1;
-		}
-	}
+static ALWAYS_INLINE void lda_indx(uint8_t address, cpu_core* cpu, machine* mch)
+{
+	cpu->A = load(cpu, cpu_read(cpu, mch, indx_address(address, cpu, mch)));
+	cpu->cycle += 6;
+}
 
-	if (adr == 0) {
-		mch->P = SET_ZERO(mch->P); 
-	} else {
-		mch->P = CLEAR_ZERO(mch->P);
-	}
+static ALWAYS_INLINE void lda_indy(uint8_t address, cpu_core* cpu, machine* mch)
+{
+	cpu->A = load(cpu, cpu_read(cpu, mch, indy_address(address, cpu, mch)));
+	cpu->cycle += 5;
+}
 
-	if (adr < 0) {
-		mch->P = SET_NEG(mch->P);
-	} else {
-		mch->P = CLEAR_NEG(mch->P);
-	}
+/* LDX - load X, immediate addressing */
+static ALWAYS_INLINE void ldx_imm(uint8_t value, cpu_core* cpu, machine* mch)
+{
+	cpu->X = load(cpu, value);
+	cpu->cycle += 2;
+}
 
-	mch->A = mch->memory[adr];
-	mch->cycle += 4;
-	mch->pc += 2;
+/* zero page, or zero page offset by Y */
+static ALWAYS_INLINE void ldx_zp(uint8_t address, cpu_core* cpu, machine* mch, char has_offset, uint8_t offset)
+{
+	cpu->X = load(cpu, cpu_read(cpu, mch, (uint8_t) (address + offset)));
+	cpu->cycle += 3 + has_offset;
 }
 
-void lda_zp(uint8_t adr, machine* mch, char has_offset, uint8_t offset)
+/* absolute, or absolute offset by Y */
+static ALWAYS_INLINE void ldx_abs(uint8_t high, uint8_t low, cpu_core* cpu, machine* mch, char has_offset, uint8_t offset)
 {
-	uint16_t address = (uint16_t) adr;
+	uint16_t adr = ((uint16_t) high << 8) | low;
 
 	if (has_offset) {
-		adr += offset;
-		mch->cycle += 1;
-
-		if (adr == 0) {
-			mch->P = SET_ZERO(mch->P);
-		} else {
-			mch->P = CLEAR_ZERO(mch->P);
-		}
-
-		if (adr < 0) {
-			mch->P = SET_NEG(mch->P);
-		} else {
-			mch->P = CLEAR_NEG(mch->P);
-		}
+		adr = indexed(cpu, adr, offset);
 	}
 
-	mch->A = mch->memory[adr];
-	mch->cycle += 3;
-	mch->pc += 1;
+	cpu->X = load(cpu, cpu_read(cpu, mch, adr));
+	cpu->cycle += 4;
 }
 
-void lda_indx(uint8_t top, uint8_t bot, machine* mch)
+/* LDY - load Y, absolute or absolute offset by X */
+static ALWAYS_INLINE void ldy_abs(uint8_t high, uint8_t low, cpu_core* cpu, machine* mch, char has_offset, uint8_t offset)
 {
-	adc(mch->X, &top, &mch->P);
-	adc(mch->X, &bot, &mch->P);
-	uint16_t adr = ((uint16_t) mch->memory[top] << 8) | mch->memory[bot];
-
-	if (adr == 0) {
-		mch->P = SET_ZERO(mch->P); 
-	} else {
-		mch->P = CLEAR_ZERO(mch->P);
-	}
+	uint16_t adr = ((uint16_t) high << 8) | low;
 
-	if (adr < 0) {
-		mch->P = SET_NEG(mch->P);
-	} else {
-		mch->P = CLEAR_NEG(mch->P);
+	if (has_offset) {
+		adr = indexed(cpu, adr, offset);
 	}
 
-	mch->A = mch->memory[adr];
-	mch->cycle += 6;
-	mch->pc += 2;
+	cpu->Y = load(cpu, cpu_read(cpu, mch, adr));
+	cpu->cycle += 4;
 }
 
-void lda_indy(uint8_t top, uint8_t bot, machine* mch)
+/* immediate addressing */
+static ALWAYS_INLINE void ldy_imm(uint8_t value, cpu_core* cpu, machine* mch)
 {
-	uint16_t adr = ((uint16_t) mch->memory[top] << 8) | mch->memory[bot];
-	adc_16(mch->Y, &adr, &mch->P);
-	adr = mch->memory[adr];
-
-	if (page_check(mch->pc, adr) != 1) {
-		mch->cycle += 1;
-	}
-
-	if (adr == 0) {
-		mch->P = SET_ZERO(mch->P); 
-	} else {
-		mch->P = CLEAR_ZERO(mch->P);
-	}
-
-	if (adr < 0) {
-		mch->P = SET_NEG(mch->P);
-	} else {
-		mch->P = CLEAR_NEG(mch->P);
-	}
-
-	mch->A = mch->memory[adr];
-	mch->cycle += 5;
-	mch->pc += 2;
+	cpu->Y = load(cpu, value);
+	cpu->cycle += 2;
 }
 
-void ldx_imm(uint8_t adr, machine* mch)
+/* zero page, or zero page offset by X */
+static ALWAYS_INLINE void ldy_zp(uint8_t address, cpu_core* cpu, machine* mch, char has_offset, uint8_t offset)
 {
-	if (adr == 0) {
-		mch->P = SET_ZERO(mch->P); 
-	} else {
-		mch->P = CLEAR_ZERO(mch->P);
-	}
-
-	if (adr < 0) {
-		mch->P = SET_NEG(mch->P);
-	} else {
-		mch->P = CLEAR_NEG(mch->P);
-	}
-
-	mch->X = mch->memory[adr];
-	mch->cycle += 2;
-	mch->pc += 1;
+	cpu->Y = load(cpu, cpu_read(cpu, mch, (uint8_t) (address + offset)));
+	cpu->cycle += 3 + has_offset;
 }
 
-void ldx_zp(uint8_t adr, machine* mch, char has_offset, uint8_t offset)
+/* STA - store A, zero page */
+static ALWAYS_INLINE void sta_zp(uint8_t address, cpu_core* cpu, machine* mch)
 {
-	uint16_t address = (uint16_t) adr;
-
-	if (has_offset) {
-		adr += offset;
-		mch->cycle += 1;
-
-		if (adr == 0) {
-			mch->P = SET_ZERO(mch->P);
-		} else {
-			mch->P = CLEAR_ZERO(mch->P);
-		}
+	cpu_write(cpu, mch, address, cpu->A);
+	cpu->cycle += 3;
+}
 
-		if (adr < 0) {
-			mch->P = SET_NEG(mch->P);
-		} else {
-			mch->P = CLEAR_NEG(mch->P);
-		}
-	}
+static ALWAYS_INLINE void sta_zpx(uint8_t address, cpu_core* cpu, machine* mch)
+{
+	cpu_write(cpu, mch, (uint8_t) (address + cpu->X), cpu->A);
+	cpu->cycle += 4;
+}
 
-	mch->X = mch->memory[adr];
-	mch->cycle += 3;
-	mch->pc += 1;
+static ALWAYS_INLINE void sta_abs(uint8_t high, uint8_t low, cpu_core* cpu, machine* mch)
+{
+	cpu_write(cpu, mch, ((uint16_t) high << 8) | low, cpu->A);
+	cpu->cycle += 4;
 }
 
-void ldx_abs(uint8_t top, uint8_t bot, machine* mch, char has_offset, uint8_t offset)
+/* stores always take the extra cycle of an indexed address */
+static ALWAYS_INLINE void sta_absx(uint8_t high, uint8_t low, cpu_core* cpu, machine* mch)
 {
-	uint16_t adr = ((uint16_t) top << 8) | bot;
+	cpu_write(cpu, mch, (((uint16_t) high << 8) | low) + cpu->X, cpu->A);
+	cpu->cycle += 5;
+}
 
-	if (has_offset) {
-		adr += offset;
-		if (page_check(adr, mch->pc) != 1) {
-			mch->cycle += 1;
-		}
-	}
+static ALWAYS_INLINE void sta_absy(uint8_t high, uint8_t low, cpu_core* cpu, machine* mch)
+{
+	cpu_write(cpu, mch, (((uint16_t) high << 8) | low) + cpu->Y, cpu->A);
+	cpu->cycle += 5;
+}
 
-	if (adr == 0) {
-		mch->P = SET_ZERO(mch->P); 
-	} else {
-		mch->P = CLEAR_ZERO(mch->P);
-	}
+static ALWAYS_INLINE void sta_indx(uint8_t address, cpu_core* cpu, machine* mch)
+{
+	cpu_write(cpu, mch, indx_address(address, cpu, mch), cpu->A);
+	cpu->cycle += 6;
+}
 
-	if (adr < 0) {
-		mch->P = SET_NEG(mch->P);
-	} else {
-		mch->P = CLEAR_NEG(mch->P);
-	}
+static ALWAYS_INLINE void sta_indy(uint8_t address, cpu_core* cpu, machine* mch)
+{
+	uint16_t base = cpu_read(cpu, mch, address) | ((uint16_t) cpu_read(cpu, mch, (uint8_t) (address + 1)) << 8);
+	cpu_write(cpu, mch, base + cpu->Y, cpu->A);
+	cpu->cycle += 6;
+}
 
-	mch->X = mch->memory[adr];
-	mch->cycle += 4;
-	mch->pc += 2;
+/* STX - store X, zero page, or zero page offset by Y */
+static ALWAYS_INLINE void stx_zp(uint8_t address, cpu_core* cpu, machine* mch, char has_offset, uint8_t offset)
+{
+	cpu_write(cpu, mch, (uint8_t) (address + offset), cpu->X);
+	cpu->cycle += 3 + has_offset;
 }
 
-void ldy_abs(uint8_t top, uint8_t bot, machine* mch, char has_offset, uint8_t offset)
+static ALWAYS_INLINE void stx_abs(uint8_t high, uint8_t low, cpu_core* cpu, machine* mch)
 {
-	uint16_t adr = ((uint16_t) top << 8) | bot;
+	cpu_write(cpu, mch, ((uint16_t) high << 8) | low, cpu->X);
+	cpu->cycle += 4;
+}
 
-	if (has_offset) {
-		adr += offset;
-		if (page_check(adr, mch->pc) != 1) {
-			mch->cycle += 1;
-		}
-	}
+/* STY - store Y, zero page, or zero page offset by X */
+static ALWAYS_INLINE void sty_zp(uint8_t address, cpu_core* cpu, machine* mch, char has_offset, uint8_t offset)
+{
+	cpu_write(cpu, mch, (uint8_t) (address + offset), cpu->Y);
+	cpu->cycle += 3 + has_offset;
+}
 
-	if (adr == 0) {
-		mch->P = SET_ZERO(mch->P); 
-	} else {
-		mch->P = CLEAR_ZERO(mch->P);
-	}
+static ALWAYS_INLINE void sty_abs(uint8_t high, uint8_t low, cpu_core* cpu, machine* mch)
+{
+	cpu_write(cpu, mch, ((uint16_t) high << 8) | low, cpu->Y);
+	cpu->cycle += 4;
+}
 
-	if (adr < 0) {
-		mch->P = SET_NEG(mch->P);
-	} else {
-		mch->P = CLEAR_NEG(mch->P);
-	}
+static ALWAYS_INLINE void sei(cpu_core* cpu, machine* mch)
+{
+	cpu->P = SET_INTERRUPT(cpu->P);
+	cpu->cycle += 2;
+}
 
-	mch->Y = mch->memory[adr];
-	mch->cycle += 4;
-	mch->pc += 2;
+static ALWAYS_INLINE void sec(cpu_core* cpu, machine* mch)
+{
+	cpu->P = SET_CARRY(cpu->P);
+	cpu->cycle += 2;
 }
 
-void ldy_imm(uint8_t adr, machine* mch)
+/* SED - set decimal, only the NMOS and 65C02 builds do decimal arithmetic */
+static ALWAYS_INLINE void sed(cpu_core* cpu, machine* mch)
 {
-	if (adr == 0) {
-		mch->P = SET_ZERO(mch->P); 
-	} else {
-		mch->P = CLEAR_ZERO(mch->P);
-	}
+	cpu->P = SET_DECIMAL(cpu->P);
+	cpu->cycle += 2;
+}
 
-	if (adr < 0) {
-		mch->P = SET_NEG(mch->P);
-	} else {
-		mch->P = CLEAR_NEG(mch->P);
-	}
 
-	mch->Y = mch->memory[adr];
-	mch->cycle += 2;
-	mch->pc += 1;
+/* PHP - push P, with B and bit 5 set in the copy on the stack */
+static ALWAYS_INLINE void php(cpu_core* cpu, machine* mch)
+{	
+	push(cpu, mch, cpu->P | FLAG_B | 0b00100000);
+	cpu->cycle += 3;
 }
 
-void ldy_zp(uint8_t adr, machine* mch, char has_offset, uint8_t offset)
+/* PLP - pull P, B does not exist in the register and bit 5 stays set */
+static ALWAYS_INLINE void plp(cpu_core* cpu, machine* mch)
 {
-	uint16_t address = (uint16_t) adr;
-
-	if (has_offset) {
-		adr += offset;
-		mch->cycle += 1;
+	cpu->P = (pull(cpu, mch) & ~FLAG_B) | 0b00100000;
+	cpu->cycle += 4;
+}
 
-		if (adr == 0) {
-			mch->P = SET_ZERO(mch->P);
-		} else {
-			mch->P = CLEAR_ZERO(mch->P);
-		}
+static ALWAYS_INLINE void pha(cpu_core* cpu, machine* mch)
+{
+	push(cpu, mch, cpu->A);
+	cpu->cycle += 3;
+}
 
-		if (adr < 0) {
-			mch->P = SET_NEG(mch->P);
-		} else {
-			mch->P = CLEAR_NEG(mch->P);
-		}
-	}
+/* PLA - pull A, setting N and Z */
+static ALWAYS_INLINE void pla(cpu_core* cpu, machine* mch)
+{
+	cpu->A = load(cpu, pull(cpu, mch));
+	cpu->cycle += 4;
+}
 
-	mch->Y = mch->memory[adr];
-	mch->cycle += 3;
-	mch->pc += 1;
+/* TAX, TAY, TYA, TXA - transfers, setting N and Z from the value */
+static ALWAYS_INLINE void tax(cpu_core* cpu, machine* mch)
+{
+	cpu->X = load(cpu, cpu->A);
+	cpu->cycle += 2;
 }
 
-void sei(machine* mch)
+static ALWAYS_INLINE void tay(cpu_core* cpu, machine* mch)
 {
-	mch->P = SET_INTERRUPT(mch->P);
-	mch->cycle += 2;
+	cpu->Y = load(cpu, cpu->A);
+	cpu->cycle += 2;
 }
 
-void sec(machine* mch)
+static ALWAYS_INLINE void tya(cpu_core* cpu, machine* mch)
 {
-	mch->P = SET_CARRY(mch->P);
-	mch->cycle += 2;
+	cpu->A = load(cpu, cpu->Y);
+	cpu->cycle += 2;
 }
 
-void php(machine* mch)
-{	
-	mch->stack_head++;
-	mch->stack[mch->stack_head] = mch->P;
-	mch->cycle += 3;
+static ALWAYS_INLINE void txa(cpu_core* cpu, machine* mch)
+{
+	cpu->A = load(cpu, cpu->X);
+	cpu->cycle += 2;
 }
 
-void plp(machine* mch)
+static ALWAYS_INLINE void jsr(uint8_t high, uint8_t low, cpu_core* cpu, machine* mch)
 {
-	mch->P = mch->stack[mch->stack_head];
-	mch->stack_head--;
-	mch->cycle += 4;
+	// push the address of the last byte of the jsr, high byte first
+	uint16_t ret = cpu->pc - 1;
+	push(cpu, mch, ret >> 8);
+	push(cpu, mch, ret & 0x00FF);
+	cpu->pc = ((uint16_t) high << 8) | low;
+	cpu->cycle += 6;
 }
 
-void pha(machine* mch)
+static ALWAYS_INLINE void rts(cpu_core* cpu, machine* mch)
 {
-	mch->stack_head++;
-	mch->stack[mch->stack_head] = mch->A;
-	mch->cycle += 3;
+	uint16_t adr = pull(cpu, mch);
+	adr = adr | ((uint16_t) pull(cpu, mch) << 8);
+	cpu->pc = adr + 1;
+	cpu->cycle += 6;
 }
 
-void pla(machine* mch)
+static ALWAYS_INLINE void rti(cpu_core* cpu, machine* mch)
 {
-	mch->A = mch->stack[mch->stack_head];
-	mch->stack_head--;
-	mch->cycle += 4;
+	// get processor status, as plp does
+	cpu->P = (pull(cpu, mch) & ~FLAG_B) | 0b00100000;
+	// get the low byte, then the high byte
+	cpu->pc = pull(cpu, mch);
+	cpu->pc |= (uint16_t) pull(cpu, mch) << 8; // unlike rts, this is just the address, not address + 1
+	cpu->cycle += 6;
 }
 
-void tax(machine* mch)
+/*
+* Fused instructions, found by fuse_ops in decode.c. op is the decoded
+* first instruction and the ones after it. pc is already past the first,
+* as for any handler, and is moved past each of the others before it
+* runs. They stop between instructions wherever run would have, so fusing
+* never moves the instruction a frame or a profiler sample falls on.
+*/
+static ALWAYS_INLINE int fused_stop(cpu_core* cpu)
 {
-	mch->X = mch->A;
+	return cpu->cycle >= cpu->deadline || cpu->status != CPU_RUNNING;
+}
 
-	if (mch->X == 0) {
-		mch->P = SET_ZERO(mch->P);
-	} else {
-		mch->P = CLEAR_ZERO(mch->P);
-	}
+/* DEX/BNE and DEY/BNE, looping here while the branch goes back to the DEX */
+static ALWAYS_INLINE void fused_dec_bne(const decoded_op* op, cpu_core* cpu, machine* mch, char y)
+{
+	uint16_t start = cpu->pc - 1;
 
-	if (mch->X < 0) {
-		mch->P = SET_NEG(mch->P);
-	} else {
-		mch->P = CLEAR_NEG(mch->P);
+	for (;;) {
+		if (y) {
+			dey(cpu, mch);
+		} else {
+			dex(cpu, mch);
+		}
+		if (fused_stop(cpu)) {
+			return;
+		}
+		cpu->pc += 2;
+		branch_clear(op[1].operand[0], cpu, mch, FLAG_Z);
+		if (cpu->pc != start || fused_stop(cpu)) {
+			return;
+		}
+		cpu->pc += 1;
 	}
-
-	mch->cycle += 2;
 }
 
-void tay(machine* mch)
+/* INX/CPX #/BNE, the same for loops counting up */
+static ALWAYS_INLINE void fused_inx_cpx_bne(const decoded_op* op, cpu_core* cpu, machine* mch)
 {
-	mch->Y = mch->A;
+	uint16_t start = cpu->pc - 1;
 
-	if (mch->Y == 0) {
-		mch->P = SET_ZERO(mch->P);
-	} else {
-		mch->P = CLEAR_ZERO(mch->P);
+	for (;;) {
+		inx(cpu, mch);
+		if (fused_stop(cpu)) {
+			return;
+		}
+		cpu->pc += 2;
+		cpx_imm(op[1].operand[0], cpu, mch);
+		if (fused_stop(cpu)) {
+			return;
+		}
+		cpu->pc += 2;
+		branch_clear(op[3].operand[0], cpu, mch, FLAG_Z);
+		if (cpu->pc != start || fused_stop(cpu)) {
+			return;
+		}
+		cpu->pc += 1;
 	}
+}
 
-	if (mch->Y < 0) {
-		mch->P = SET_NEG(mch->P);
+/* CLC/ADC and SEC/SBC, immediate or zero page */
+static ALWAYS_INLINE void fused_clc_adc(const decoded_op* op, cpu_core* cpu, machine* mch, char zp)
+{
+	clc(cpu, mch);
+	if (fused_stop(cpu)) {
+		return;
+	}
+	cpu->pc += 2;
+	if (zp) {
+		adc_zp(op[1].operand[0], cpu, mch);
 	} else {
-		mch->P = CLEAR_NEG(mch->P);
+		adc_imm(op[1].operand[0], cpu, mch);
 	}
-
-	mch->cycle += 2;	
 }
 
-void tya(machine* mch)
+static ALWAYS_INLINE void fused_sec_sbc(const decoded_op* op, cpu_core* cpu, machine* mch, char zp)
 {
-	mch->A = mch->Y;
-
-	if (mch->A == 0) {
-		mch->P = SET_ZERO(mch->P);
-	} else {
-		mch->P = CLEAR_ZERO(mch->P);
+	sec(cpu, mch);
+	if (fused_stop(cpu)) {
+		return;
 	}
-
-	if (mch->A < 0) {
-		mch->P = SET_NEG(mch->P);
+	cpu->pc += 2;
+	if (zp) {
+		sbc_zp(op[1].operand[0], cpu, mch);
 	} else {
-		mch->P = CLEAR_NEG(mch->P);
+		sbc_imm(op[1].operand[0], cpu, mch);
 	}
-
-	mch->cycle += 2;	
 }
 
-void txa(machine* mch)
+/* LDA #/STA abs, setting up a register */
+static ALWAYS_INLINE void fused_lda_imm_sta_abs(const decoded_op* op, cpu_core* cpu, machine* mch)
 {
-	mch->A = mch->X;
-
-	if (mch->A == 0) {
-		mch->P = SET_ZERO(mch->P);
-	} else {
-		mch->P = CLEAR_ZERO(mch->P);
+	lda_imm(op[0].operand[0], cpu, mch);
+	if (fused_stop(cpu)) {
+		return;
 	}
+	cpu->pc += 3;
+	sta_abs(op[2].operand[1], op[2].operand[0], cpu, mch);
+}
 
-	if (mch->A < 0) {
-		mch->P = SET_NEG(mch->P);
-	} else {
-		mch->P = CLEAR_NEG(mch->P);
+/* LDA/STA with the same addressing on both, the body of a copy loop */
+static ALWAYS_INLINE void fused_lda_sta_zp(const decoded_op* op, cpu_core* cpu, machine* mch)
+{
+	lda_zp(op[0].operand[0], cpu, mch, 0, 0);
+	if (fused_stop(cpu)) {
+		return;
 	}
-
-	mch->cycle += 2;	
+	cpu->pc += 2;
+	sta_zp(op[2].operand[0], cpu, mch);
 }
 
-void jsr(uint8_t high, uint8_t low, machine* mch)
+static ALWAYS_INLINE void fused_lda_sta_absx(const decoded_op* op, cpu_core* cpu, machine* mch)
 {
-	// push pc to the stack
-	uint8_t pc_high, pc_low;
-	pc_high = mch->pc >> 8;
-	pc_low = mch->pc & 0x00FF;
-	mch->stack_head++;
-	mch->stack[mch->stack_head] = pc_low;
-	mch->stack_head++;
-	mch->stack[mch->stack_head] = pc_high;
-	// set pc to the given address-1
-	mch->pc = (((uint16_t) high << 8) | low) - 1;
-	mch->cycle += 6;
+	lda_abs(op[0].operand[1], op[0].operand[0], cpu, mch, 1, cpu->X);
+	if (fused_stop(cpu)) {
+		return;
+	}
+	cpu->pc += 3;
+	sta_absx(op[3].operand[1], op[3].operand[0], cpu, mch);
 }
 
-void rts(machine* mch)
+static ALWAYS_INLINE void fused_lda_sta_absy(const decoded_op* op, cpu_core* cpu, machine* mch)
 {
-	uint16_t adr = mch->stack[mch->stack_head];
-	mch->stack_head--;
-	adr = adr | ((uint16_t) mch->stack[mch->stack_head] << 8);
-	mch->pc = adr + 1;
-	mch->cycle += 6;
+	lda_abs(op[0].operand[1], op[0].operand[0], cpu, mch, 1, cpu->Y);
+	if (fused_stop(cpu)) {
+		return;
+	}
+	cpu->pc += 3;
+	sta_absy(op[3].operand[1], op[3].operand[0], cpu, mch);
 }
 
-void rti(machine* mch)
+static ALWAYS_INLINE void fused_lda_sta_indy(const decoded_op* op, cpu_core* cpu, machine* mch)
 {
-	// get processor status
-	mch->P = mch->stack[mch->stack_head];
-	mch->stack_head--;
-	// get the high byte
-	mch->pc = (uint16_t)(mch->stack[mch->stack_head] << 8);
-	mch->stack_head--;
-	// get the low byte
-	mch->pc &= mch->stack[mch->stack_head]; // unlike rts, this is just the address, not address + 1
-	mch->stack_head--;
-	mch->cycle += 6;
+	lda_indy(op[0].operand[0], cpu, mch);
+	if (fused_stop(cpu)) {
+		return;
+	}
+	cpu->pc += 2;
+	sta_indy(op[2].operand[0], cpu, mch);
 }
 
+/*
+* A branch or JMP closing a loop of instructions that only read memory
+* (see fuse_idle), usually polling for vblank. Nothing but the registers
+* can change from one pass to the next, so once two passes start with
+* the same registers all later ones do too, and the passes that would
+* end before the deadline are skipped by adding their cycles. The last
+* pass still runs, so the loop stops on the same instruction as without.
+*/
+static ALWAYS_INLINE void fused_idle(const decoded_op* op, cpu_core* cpu, machine* mch)
+{
+	uint16_t at = cpu->pc - op->length;
+	idle_loop* idle = &mch->idle;
+
+	switch (op->opcode) {
+		case 0x10: branch_clear(op->operand[0], cpu, mch, FLAG_N); break;
+		case 0x30: branch_set(op->operand[0], cpu, mch, FLAG_N); break;
+		case 0x50: branch_clear(op->operand[0], cpu, mch, FLAG_V); break;
+		case 0x70: branch_set(op->operand[0], cpu, mch, FLAG_V); break;
+		case 0x90: branch_clear(op->operand[0], cpu, mch, FLAG_C); break;
+		case 0xB0: branch_set(op->operand[0], cpu, mch, FLAG_C); break;
+		case 0xD0: branch_clear(op->operand[0], cpu, mch, FLAG_Z); break;
+		case 0xF0: branch_set(op->operand[0], cpu, mch, FLAG_Z); break;
+		case 0x4C: jmp_abs(op->operand[1], op->operand[0], cpu, mch); break;
+	}
+
+	// left the loop, or a jmp to another page
+	if (cpu->pc > at || (cpu->pc >> 8) != (at >> 8)) {
+		idle->cycle = -1;
+		return;
+	}
+
+	if (idle->cycle >= 0 && idle->pc == at && idle->A == cpu->A && idle->X == cpu->X && idle->Y == cpu->Y && idle->P == cpu->P && !mch->watch && cpu->cycle < cpu->deadline) {
+		int64_t pass = cpu->cycle - idle->cycle;
+		cpu->cycle += (cpu->deadline - 1 - cpu->cycle) / pass * pass;
+	}
+
+	idle->pc = at;
+	idle->A = cpu->A;
+	idle->X = cpu->X;
+	idle->Y = cpu->Y;
+	idle->P = cpu->P;
+	idle->cycle = cpu->cycle;
+}
@@ -0,0 +1,261 @@
+#include <stdint.h>
+#include "optable.h"
+
+const opcode_info opcode_table[256] = {
+	{"BRK", MODE_IMP, 1}, // 00
+	{"ORA", MODE_INDX, 2}, // 01
+	{"KIL", MODE_IMP, 1}, // 02
+	{"???", MODE_IMP, 1}, // 03
+	{"???", MODE_IMP, 1}, // 04
+	{"ORA", MODE_ZP, 2}, // 05
+	{"ASL", MODE_ZP, 2}, // 06
+	{"???", MODE_IMP, 1}, // 07
+	{"PHP", MODE_IMP, 1}, // 08
+	{"ORA", MODE_IMM, 2}, // 09
+	{"ASL", MODE_ACC, 1}, // 0A
+	{"???", MODE_IMP, 1}, // 0B
+	{"???", MODE_IMP, 1}, // 0C
+	{"ORA", MODE_ABS, 3}, // 0D
+	{"ASL", MODE_ABS, 3}, // 0E
+	{"???", MODE_IMP, 1}, // 0F
+	{"BPL", MODE_REL, 2}, // 10
+	{"ORA", MODE_INDY, 2}, // 11
+	{"KIL", MODE_IMP, 1}, // 12
+	{"???", MODE_IMP, 1}, // 13
+	{"???", MODE_IMP, 1}, // 14
+	{"ORA", MODE_ZPX, 2}, // 15
+	{"ASL", MODE_ZPX, 2}, // 16
+	{"???", MODE_IMP, 1}, // 17
+	{"CLC", MODE_IMP, 1}, // 18
+	{"ORA", MODE_ABSY, 3}, // 19
+	{"NOP", MODE_IMP, 1}, // 1A
+	{"???", MODE_IMP, 1}, // 1B
+	{"???", MODE_IMP, 1}, // 1C
+	{"ORA", MODE_ABSX, 3}, // 1D
+	{"ASL", MODE_ABSX, 3}, // 1E
+	{"???", MODE_IMP, 1}, // 1F
+	{"JSR", MODE_ABS, 3}, // 20
+	{"AND", MODE_INDX, 2}, // 21
+	{"KIL", MODE_IMP, 1}, // 22
+	{"???", MODE_IMP, 1}, // 23
+	{"BIT", MODE_ZP, 2}, // 24
+	{"AND", MODE_ZP, 2}, // 25
+	{"ROL", MODE_ZP, 2}, // 26
+	{"???", MODE_IMP, 1}, // 27
+	{"PLP", MODE_IMP, 1}, // 28
+	{"AND", MODE_IMM, 2}, // 29
+	{"ROL", MODE_ACC, 1}, // 2A
+	{"???", MODE_IMP, 1}, // 2B
+	{"BIT", MODE_ABS, 3}, // 2C
+	{"AND", MODE_ABS, 3}, // 2D
+	{"ROL", MODE_ABS, 3}, // 2E
+	{"???", MODE_IMP, 1}, // 2F
+	{"BMI", MODE_REL, 2}, // 30
+	{"AND", MODE_INDY, 2}, // 31
+	{"KIL", MODE_IMP, 1}, // 32
+	{"???", MODE_IMP, 1}, // 33
+	{"???", MODE_IMP, 1}, // 34
+	{"AND", MODE_ZPX, 2}, // 35
+	{"ROL", MODE_ZPX, 2}, // 36
+	{"???", MODE_IMP, 1}, // 37
+	{"SEC", MODE_IMP, 1}, // 38
+	{"AND", MODE_ABSY, 3}, // 39
+	{"???", MODE_IMP, 1}, // 3A
+	{"???", MODE_IMP, 1}, // 3B
+	{"???", MODE_IMP, 1}, // 3C
+	{"AND", MODE_ABSX, 3}, // 3D
+	{"ROL", MODE_ABSX, 3}, // 3E
+	{"???", MODE_IMP, 1}, // 3F
+	{"RTI", MODE_IMP, 1}, // 40
+	{"EOR", MODE_INDX, 2}, // 41
+	{"KIL", MODE_IMP, 1}, // 42
+	{"???", MODE_IMP, 1}, // 43
+	{"???", MODE_IMP, 1}, // 44
+	{"EOR", MODE_ZP, 2}, // 45
+	{"LSR", MODE_ZP, 2}, // 46
+	{"???", MODE_IMP, 1}, // 47
+	{"PHA", MODE_IMP, 1}, // 48
+	{"EOR", MODE_IMM, 2}, // 49
+	{"LSR", MODE_ACC, 1}, // 4A
+	{"???", MODE_IMP, 1}, // 4B
+	{"JMP", MODE_ABS, 3}, // 4C
+	{"EOR", MODE_ABS, 3}, // 4D
+	{"LSR", MODE_ABS, 3}, // 4E
+	{"???", MODE_IMP, 1}, // 4F
+	{"BVC", MODE_REL, 2}, // 50
+	{"EOR", MODE_INDY, 2}, // 51
+	{"KIL", MODE_IMP, 1}, // 52
+	{"???", MODE_IMP, 1}, // 53
+	{"???", MODE_IMP, 1}, // 54
+	{"EOR", MODE_ZPX, 2}, // 55
+	{"LSR", MODE_ZPX, 2}, // 56
+	{"???", MODE_IMP, 1}, // 57
+	{"CLI", MODE_IMP, 1}, // 58
+	{"EOR", MODE_ABSY, 3}, // 59
+	{"???", MODE_IMP, 1}, // 5A
+	{"???", MODE_IMP, 1}, // 5B
+	{"???", MODE_IMP, 1}, // 5C
+	{"EOR", MODE_ABSX, 3}, // 5D
+	{"LSR", MODE_ABSX, 3}, // 5E
+	{"???", MODE_IMP, 1}, // 5F
+	{"RTS", MODE_IMP, 1}, // 60
+	{"ADC", MODE_INDX, 2}, // 61
+	{"KIL", MODE_IMP, 1}, // 62
+	{"???", MODE_IMP, 1}, // 63
+	{"???", MODE_IMP, 1}, // 64
+	{"ADC", MODE_ZP, 2}, // 65
+	{"ROR", MODE_ZP, 2}, // 66
+	{"???", MODE_IMP, 1}, // 67
+	{"PLA", MODE_IMP, 1}, // 68
+	{"ADC", MODE_IMM, 2}, // 69
+	{"ROR", MODE_ACC, 1}, // 6A
+	{"???", MODE_IMP, 1}, // 6B
+	{"JMP", MODE_IND, 3}, // 6C
+	{"ADC", MODE_ABS, 3}, // 6D
+	{"ROR", MODE_ABS, 3}, // 6E
+	{"???", MODE_IMP, 1}, // 6F
+	{"BVS", MODE_REL, 2}, // 70
+	{"ADC", MODE_INDY, 2}, // 71
+	{"KIL", MODE_IMP, 1}, // 72
+	{"???", MODE_IMP, 1}, // 73
+	{"???", MODE_IMP, 1}, // 74
+	{"ADC", MODE_ZPX, 2}, // 75
+	{"ROR", MODE_ZPX, 2}, // 76
+	{"???", MODE_IMP, 1}, // 77
+	{"SEI", MODE_IMP, 1}, // 78
+	{"ADC", MODE_ABSY, 3}, // 79
+	{"NOP", MODE_IMP, 1}, // 7A
+	{"???", MODE_IMP, 1}, // 7B
+	{"???", MODE_IMP, 1}, // 7C
+	{"ADC", MODE_ABSX, 3}, // 7D
+	{"ROR", MODE_ABSX, 3}, // 7E
+	{"???", MODE_IMP, 1}, // 7F
+	{"???", MODE_IMP, 1}, // 80
+	{"STA", MODE_INDX, 2}, // 81
+	{"???", MODE_IMP, 1}, // 82
+	{"???", MODE_IMP, 1}, // 83
+	{"STY", MODE_ZP, 2}, // 84
+	{"STA", MODE_ZP, 2}, // 85
+	{"STX", MODE_ZP, 2}, // 86
+	{"???", MODE_IMP, 1}, // 87
+	{"DEY", MODE_IMP, 1}, // 88
+	{"???", MODE_IMP, 1}, // 89
+	{"TXA", MODE_IMP, 1}, // 8A
+	{"???", MODE_IMP, 1}, // 8B
+	{"STY", MODE_ABS, 3}, // 8C
+	{"STA", MODE_ABS, 3}, // 8D
+	{"STX", MODE_ABS, 3}, // 8E
+	{"???", MODE_IMP, 1}, // 8F
+	{"BCC", MODE_REL, 2}, // 90
+	{"STA", MODE_INDY, 2}, // 91
+	{"KIL", MODE_IMP, 1}, // 92
+	{"???", MODE_IMP, 1}, // 93
+	{"STY", MODE_ZPX, 2}, // 94
+	{"STA", MODE_ZPX, 2}, // 95
+	{"STX", MODE_ZPY, 2}, // 96
+	{"???", MODE_IMP, 1}, // 97
+	{"TYA", MODE_IMP, 1}, // 98
+	{"STA", MODE_ABSY, 3}, // 99
+	{"TXS", MODE_IMP, 1}, // 9A
+	{"???", MODE_IMP, 1}, // 9B
+	{"???", MODE_IMP, 1}, // 9C
+	{"STA", MODE_ABSX, 3}, // 9D
+	{"???", MODE_IMP, 1}, // 9E
+	{"???", MODE_IMP, 1}, // 9F
+	{"LDY", MODE_IMM, 2}, // A0
+	{"LDA", MODE_INDX, 2}, // A1
+	{"LDX", MODE_IMM, 2}, // A2
+	{"???", MODE_IMP, 1}, // A3
+	{"LDY", MODE_ZP, 2}, // A4
+	{"LDA", MODE_ZP, 2}, // A5
+	{"LDX", MODE_ZP, 2}, // A6
+	{"???", MODE_IMP, 1}, // A7
+	{"TAY", MODE_IMP, 1}, // A8
+	{"LDA", MODE_IMM, 2}, // A9
+	{"TAX", MODE_IMP, 1}, // AA
+	{"???", MODE_IMP, 1}, // AB
+	{"LDY", MODE_ABS, 3}, // AC
+	{"LDA", MODE_ABS, 3}, // AD
+	{"LDX", MODE_ABS, 3}, // AE
+	{"???", MODE_IMP, 1}, // AF
+	{"BCS", MODE_REL, 2}, // B0
+	{"LDA", MODE_INDY, 2}, // B1
+	{"KIL", MODE_IMP, 1}, // B2
+	{"???", MODE_IMP, 1}, // B3
+	{"LDY", MODE_ZPX, 2}, // B4
+	{"LDA", MODE_ZPX, 2}, // B5
+	{"LDX", MODE_ZPY, 2}, // B6
+	{"???", MODE_IMP, 1}, // B7
+	{"CLV", MODE_IMP, 1}, // B8
+	{"LDA", MODE_ABSY, 3}, // B9
+	{"TSX", MODE_IMP, 1}, // BA
+	{"???", MODE_IMP, 1}, // BB
+	{"LDY", MODE_ABSX, 3}, // BC
+	{"LDA", MODE_ABSX, 3}, // BD
+	{"LDX", MODE_ABSY, 3}, // BE
+	{"???", MODE_IMP, 1}, // BF
+	{"CPY", MODE_IMM, 2}, // C0
+	{"CMP", MODE_INDX, 2}, // C1
+	{"???", MODE_IMP, 1}, // C2
+	{"???", MODE_IMP, 1}, // C3
+	{"CPY", MODE_ZP, 2}, // C4
+	{"CMP", MODE_ZP, 2}, // C5
+	{"DEC", MODE_ZP, 2}, // C6
+	{"???", MODE_IMP, 1}, // C7
+	{"INY", MODE_IMP, 1}, // C8
+	{"CMP", MODE_IMM, 2}, // C9
+	{"DEX", MODE_IMP, 1}, // CA
+	{"???", MODE_IMP, 1}, // CB
+	{"CPY", MODE_ABS, 3}, // CC
+	{"CMP", MODE_ABS, 3}, // CD
+	{"DEC", MODE_ABS, 3}, // CE
+	{"???", MODE_IMP, 1}, // CF
+	{"BNE", MODE_REL, 2}, // D0
+	{"CMP", MODE_INDY, 2}, // D1
+	{"KIL", MODE_IMP, 1}, // D2
+	{"???", MODE_IMP, 1}, // D3
+	{"???", MODE_IMP, 1}, // D4
+	{"CMP", MODE_ZPX, 2}, // D5
+	{"DEC", MODE_ZPX, 2}, // D6
+	{"???", MODE_IMP, 1}, // D7
+	{"CLD", MODE_IMP, 1}, // D8
+	{"CMP", MODE_ABSY, 3}, // D9
+	{"???", MODE_IMP, 1}, // DA
+	{"???", MODE_IMP, 1}, // DB
+	{"???", MODE_IMP, 1}, // DC
+	{"CMP", MODE_ABSX, 3}, // DD
+	{"DEC", MODE_ABSX, 3}, // DE
+	{"???", MODE_IMP, 1}, // DF
+	{"CPX", MODE_IMM, 2}, // E0
+	{"SBC", MODE_INDX, 2}, // E1
+	{"???", MODE_IMP, 1}, // E2
+	{"???", MODE_IMP, 1}, // E3
+	{"CPX", MODE_ZP, 2}, // E4
+	{"SBC", MODE_ZP, 2}, // E5
+	{"INC", MODE_ZP, 2}, // E6
+	{"???", MODE_IMP, 1}, // E7
+	{"INX", MODE_IMP, 1}, // E8
+	{"SBC", MODE_IMM, 2}, // E9
+	{"NOP", MODE_IMP, 1}, // EA
+	{"???", MODE_IMP, 1}, // EB
+	{"CPX", MODE_ABS, 3}, // EC
+	{"SBC", MODE_ABS, 3}, // ED
+	{"INC", MODE_ABS, 3}, // EE
+	{"???", MODE_IMP, 1}, // EF
+	{"BEQ", MODE_REL, 2}, // F0
+	{"SBC", MODE_INDY, 2}, // F1
+	{"KIL", MODE_IMP, 1}, // F2
+	{"???", MODE_IMP, 1}, // F3
+	{"???", MODE_IMP, 1}, // F4
+	{"SBC", MODE_ZPX, 2}, // F5
+	{"INC", MODE_ZPX, 2}, // F6
+	{"???", MODE_IMP, 1}, // F7
+	{"SED", MODE_IMP, 1}, // F8
+	{"SBC", MODE_ABSY, 3}, // F9
+	{"???", MODE_IMP, 1}, // FA
+	{"???", MODE_IMP, 1}, // FB
+	{"???", MODE_IMP, 1}, // FC
+	{"SBC", MODE_ABSX, 3}, // FD
+	{"INC", MODE_ABSX, 3}, // FE
+	{"???", MODE_IMP, 1}, // FF
+};
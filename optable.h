@@ -0,0 +1,35 @@
+#ifndef OPTABLE_H
+#define OPTABLE_H
+
+#include <stdint.h>
+
+// addressing modes
+#define MODE_IMP 0 // implied
+#define MODE_ACC 1 // accumulator
+#define MODE_IMM 2 // #$nn
+#define MODE_ZP 3 // $nn
+#define MODE_ZPX 4 // $nn,X
+#define MODE_ZPY 5 // $nn,Y
+#define MODE_ABS 6 // $nnnn
+#define MODE_ABSX 7 // $nnnn,X
+#define MODE_ABSY 8 // $nnnn,Y
+#define MODE_IND 9 // ($nnnn)
+#define MODE_INDX 10 // ($nn,X)
+#define MODE_INDY 11 // ($nn),Y
+#define MODE_REL 12 // signed offset from the next instruction
+
+/*
+* What every opcode looks like: the dispatcher reads length bytes and moves
+* pc past them, the disassembler prints the mnemonic and operand by mode.
+* Opcodes that are not documented read as "???", one byte long, except for
+* the KILs and the two illegal NOPs the core runs.
+*/
+typedef struct opcode_info {
+	char mnemonic[4];
+	uint8_t mode;
+	uint8_t length;
+} opcode_info;
+
+extern const opcode_info opcode_table[256];
+
+#endif
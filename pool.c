@@ -0,0 +1,284 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "machine.h"
+#include "alu.h"
+#include "cpu.h"
+#include "optable.h"
+#include "pool.h"
+
+#define RAM_SIZE 2048
+
+// keep old where mask is clear, take new where it is set
+#define BLEND(old, new, mask) (((old) & ~(__typeof__(old)) (mask)) | ((new) & (__typeof__(old)) (mask)))
+
+#define BRANCH_SET 0
+#define BRANCH_CLEAR 1
+
+static void* alloc_vectors(int blocks, size_t size, size_t align)
+{
+	void* v = aligned_alloc(align, blocks * size);
+	if (v) {
+		memset(v, 0, blocks * size);
+	}
+	return v;
+}
+
+/*
+* Make lanes copies of proto. The rom is shared by every lane, ram is not,
+* so lanes can be given different inputs through pool_spill/pool_fill.
+* Nothing proto has attached comes along: watchpoints, renderer, audio and
+* injected input are single consumer, and the decode cache is filled in
+* lazily as it runs.
+* The lane count is rounded up to whole blocks, the padding lanes run along
+* but are never stepped on their own. Returns NULL if lanes is below 1 or
+* out of memory.
+*/
+machine_pool* pool_create(machine* proto, int lanes)
+{
+	machine_pool* pool;
+	int i;
+
+	if (lanes < 1) {
+		return NULL;
+	}
+	pool = (machine_pool*) calloc(1, sizeof(machine_pool));
+	if (!pool) {
+		return NULL;
+	}
+
+	pool->lanes = lanes;
+	pool->blocks = (lanes + POOL_WIDTH - 1) / POOL_WIDTH;
+	pool->A = alloc_vectors(pool->blocks, sizeof(pool_u8), __alignof__(pool_u8));
+	pool->X = alloc_vectors(pool->blocks, sizeof(pool_u8), __alignof__(pool_u8));
+	pool->Y = alloc_vectors(pool->blocks, sizeof(pool_u8), __alignof__(pool_u8));
+	pool->P = alloc_vectors(pool->blocks, sizeof(pool_u8), __alignof__(pool_u8));
+	pool->S = alloc_vectors(pool->blocks, sizeof(pool_u8), __alignof__(pool_u8));
+	pool->pc = alloc_vectors(pool->blocks, sizeof(pool_u16), __alignof__(pool_u16));
+	pool->cycle = alloc_vectors(pool->blocks, sizeof(pool_i64), __alignof__(pool_i64));
+	pool->lane = (machine*) alloc_vectors(pool->blocks * POOL_WIDTH, sizeof(machine), __alignof__(machine));
+
+	if (!pool->A || !pool->X || !pool->Y || !pool->P || !pool->S || !pool->pc || !pool->cycle || !pool->lane) {
+		pool_destroy(pool);
+		return NULL;
+	}
+
+	for (i = 0; i < pool->blocks * POOL_WIDTH; i++) {
+		machine* m = &pool->lane[i];
+
+		*m = *proto;
+		m->watch = NULL;
+		m->render = NULL;
+		m->audio = NULL;
+		m->input = NULL;
+		m->input_frames = 0;
+		m->decoded = NULL;
+		m->memory = (uint8_t*) malloc(RAM_SIZE);
+		m->prg_ram = m->prg_ram_size ? (uint8_t*) malloc(m->prg_ram_size) : NULL;
+
+		if (!m->memory || (m->prg_ram_size && !m->prg_ram)) {
+			pool_destroy(pool);
+			return NULL;
+		}
+
+		memcpy(m->memory, proto->memory, RAM_SIZE);
+		if (m->prg_ram) {
+			memcpy(m->prg_ram, proto->prg_ram, m->prg_ram_size);
+		}
+
+		map_pages(m);
+		pool_fill(pool, i);
+	}
+
+	return pool;
+}
+
+void pool_destroy(machine_pool* pool)
+{
+	int i;
+
+	if (!pool) {
+		return;
+	}
+
+	if (pool->lane) {
+		for (i = 0; i < pool->blocks * POOL_WIDTH; i++) {
+			free(pool->lane[i].memory);
+			free(pool->lane[i].prg_ram);
+		}
+	}
+
+	free(pool->A);
+	free(pool->X);
+	free(pool->Y);
+	free(pool->P);
+	free(pool->S);
+	free(pool->pc);
+	free(pool->cycle);
+	free(pool->lane);
+	free(pool);
+}
+
+/* Copy a lane's registers out to its machine and return it */
+machine* pool_spill(machine_pool* pool, int lane)
+{
+	int b = lane / POOL_WIDTH, l = lane % POOL_WIDTH;
+	machine* m = &pool->lane[lane];
+
+	m->cpu.A = pool->A[b][l];
+	m->cpu.X = pool->X[b][l];
+	m->cpu.Y = pool->Y[b][l];
+	m->cpu.P = pool->P[b][l];
+	m->cpu.S = pool->S[b][l];
+	m->cpu.pc = pool->pc[b][l];
+	m->cpu.cycle = pool->cycle[b][l];
+	return m;
+}
+
+/* Copy a lane's registers back in from its machine */
+void pool_fill(machine_pool* pool, int lane)
+{
+	int b = lane / POOL_WIDTH, l = lane % POOL_WIDTH;
+	machine* m = &pool->lane[lane];
+
+	pool->A[b][l] = m->cpu.A;
+	pool->X[b][l] = m->cpu.X;
+	pool->Y[b][l] = m->cpu.Y;
+	pool->P[b][l] = m->cpu.P;
+	pool->S[b][l] = m->cpu.S;
+	pool->pc[b][l] = m->cpu.pc;
+	pool->cycle[b][l] = m->cpu.cycle;
+}
+
+/* Branch on a flag in every lane of the mask, mirrors branch_set/branch_clear */
+static void wide_branch(machine_pool* pool, int b, uint16_t next, uint16_t address, uint8_t bit, char clear, const pool_m16* same)
+{
+	pool_m8 taken8 = (pool->P[b] & bit) != 0;
+	pool_m16 taken;
+	pool_i64 extra;
+
+	if (clear) {
+		taken8 = ~taken8;
+	}
+	taken = __builtin_convertvector(taken8, pool_m16) & *same;
+
+	// a taken branch costs one more cycle, two if it lands on another page
+	extra = __builtin_convertvector(taken, pool_m64) & ((address & 0xFF00) != (next & 0xFF00) ? 2 : 1);
+
+	pool->pc[b] = BLEND(pool->pc[b], BLEND((pool_u16) {} + next, (pool_u16) {} + address, taken), *same);
+	pool->cycle[b] += (__builtin_convertvector(*same, pool_m64) & 2) + extra;
+}
+
+/*
+* Load value into dest on every lane in the mask, mirrors load in alu.h.
+* N and Z come from compares rather than nz_table, which has no vector
+* form. Vectors go by pointer, see wide_branch.
+*/
+static void wide_load(machine_pool* pool, int b, pool_u8* dest, const pool_u8* value, const pool_m8* same8)
+{
+	pool_u8 nz = (*value & FLAG_N) | ((pool_u8) (*value == 0) & FLAG_Z);
+	pool_u8 P = (pool->P[b] & (uint8_t) ~(FLAG_N | FLAG_Z)) | nz;
+
+	*dest = BLEND(*dest, *value, *same8);
+	pool->P[b] = BLEND(pool->P[b], P, *same8);
+}
+
+/*
+* Run the instruction at pc on every lane in the same mask. Only
+* instructions that touch nothing but registers are handled here, the
+* results have to match the handlers in opcodes.c exactly. Returns 0 if
+* the instruction has to go down the scalar path.
+*/
+static int wide_step(machine_pool* pool, int b, uint16_t pc, const pool_m16* same)
+{
+	machine* leader = &pool->lane[b * POOL_WIDTH];
+	uint8_t opcode = read_mem(leader, pc);
+	uint16_t address = read_mem(leader, pc + 1) | ((uint16_t) read_mem(leader, pc + 2) << 8);
+	pool_m8 same8 = __builtin_convertvector(*same, pool_m8);
+	uint16_t next = pc + opcode_table[opcode].length;
+	uint16_t target = next + (int8_t) address; // for branches
+	pool_u8 value; // for loads
+	int cycles = 2;
+
+	switch (opcode) {
+		case 0x18: pool->P[b] = BLEND(pool->P[b], CLEAR_CARRY(pool->P[b]), same8); break;
+		case 0x38: pool->P[b] = BLEND(pool->P[b], SET_CARRY(pool->P[b]), same8); break;
+		case 0x58: pool->P[b] = BLEND(pool->P[b], CLEAR_INTERRUPT(pool->P[b]), same8); break;
+		case 0x78: pool->P[b] = BLEND(pool->P[b], SET_INTERRUPT(pool->P[b]), same8); break;
+		case 0xB8: pool->P[b] = BLEND(pool->P[b], CLEAR_OVERFLOW(pool->P[b]), same8); break;
+		case 0xE8: value = pool->X[b] + 1; wide_load(pool, b, &pool->X[b], &value, &same8); break;
+		case 0xC8: value = pool->Y[b] + 1; wide_load(pool, b, &pool->Y[b], &value, &same8); break;
+		case 0xCA: value = pool->X[b] - 1; wide_load(pool, b, &pool->X[b], &value, &same8); break;
+		case 0x88: value = pool->Y[b] - 1; wide_load(pool, b, &pool->Y[b], &value, &same8); break;
+		case 0xAA: value = pool->A[b]; wide_load(pool, b, &pool->X[b], &value, &same8); break;
+		case 0xA8: value = pool->A[b]; wide_load(pool, b, &pool->Y[b], &value, &same8); break;
+		case 0x8A: value = pool->X[b]; wide_load(pool, b, &pool->A[b], &value, &same8); break;
+		case 0x98: value = pool->Y[b]; wide_load(pool, b, &pool->A[b], &value, &same8); break;
+		case 0xA9: value = (pool_u8) {} + (uint8_t) address; wide_load(pool, b, &pool->A[b], &value, &same8); break;
+		case 0xA2: value = (pool_u8) {} + (uint8_t) address; wide_load(pool, b, &pool->X[b], &value, &same8); break;
+		case 0xA0: value = (pool_u8) {} + (uint8_t) address; wide_load(pool, b, &pool->Y[b], &value, &same8); break;
+		case 0xEA: cycles = 1; break;
+		case 0x1A: break;
+		case 0x7A: break;
+		case 0x4C: next = address; cycles = 3; break;
+		case 0x90: wide_branch(pool, b, next, target, 0b00000001, BRANCH_CLEAR, same); return 1;
+		case 0xB0: wide_branch(pool, b, next, target, 0b00000001, BRANCH_SET, same); return 1;
+		case 0xD0: wide_branch(pool, b, next, target, 0b00000010, BRANCH_CLEAR, same); return 1;
+		case 0xF0: wide_branch(pool, b, next, target, 0b00000010, BRANCH_SET, same); return 1;
+		case 0x50: wide_branch(pool, b, next, target, 0b01000000, BRANCH_CLEAR, same); return 1;
+		case 0x70: wide_branch(pool, b, next, target, 0b01000000, BRANCH_SET, same); return 1;
+		case 0x10: wide_branch(pool, b, next, target, 0b10000000, BRANCH_CLEAR, same); return 1;
+		case 0x30: wide_branch(pool, b, next, target, 0b10000000, BRANCH_SET, same); return 1;
+		default: return 0;
+	}
+
+	pool->pc[b] = BLEND(pool->pc[b], (pool_u16) {} + next, *same);
+	pool->cycle[b] += __builtin_convertvector(*same, pool_m64) & cycles;
+	return 1;
+}
+
+/* Run one instruction on a single lane through the normal cpu core */
+static void scalar_step(machine_pool* pool, int lane)
+{
+	execute_cpu(pool_spill(pool, lane));
+	pool_fill(pool, lane);
+}
+
+/*
+* Run one instruction on every lane. The first lane of each block picks the
+* pc; lanes that agree with it run on the vector path if the code is in rom
+* (and so the same for every lane), everything else is stepped by itself.
+*/
+void pool_step(machine_pool* pool)
+{
+	int b, l;
+
+	for (b = 0; b < pool->blocks; b++) {
+		int base = b * POOL_WIDTH;
+		uint16_t pc = pool->pc[b][0];
+		pool_m16 same = pool->pc[b] == pc;
+
+		if (pc < 0x8000 || !wide_step(pool, b, pc, &same)) {
+			same = (pool_m16) {};
+		}
+
+		for (l = 0; l < POOL_WIDTH && base + l < pool->lanes; l++) {
+			if (same[l]) {
+				pool->wide_steps++;
+			} else {
+				scalar_step(pool, base + l);
+				pool->scalar_steps++;
+			}
+		}
+	}
+}
+
+void pool_run(machine_pool* pool, long steps)
+{
+	long i;
+
+	for (i = 0; i < steps; i++) {
+		pool_step(pool);
+	}
+}
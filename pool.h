@@ -0,0 +1,55 @@
+#ifndef POOL_H
+#define POOL_H
+
+#include <stdint.h>
+#include "machine.h"
+
+/*
+* A pool runs many machines on the same rom in lockstep. The registers of
+* every lane live in struct-of-arrays form, one vector of POOL_WIDTH lanes
+* per block, using the GCC vector extensions so the compiler picks SSE or
+* AVX2 (build with -mavx2) or plain scalar code. Lanes in a block that are
+* on the same pc run the instruction together; the rest are stepped one by
+* one through the normal cpu core.
+*
+* Only the opcodes that touch nothing but registers run wide: the flag
+* instructions, register transfers, INX/INY/DEX/DEY, immediate loads,
+* branches, JMP and NOP. Every instruction that reads or writes memory,
+* the stack included, takes the scalar path even when the whole block is
+* on it, so a rom that spends its time on loads and stores gains little.
+*/
+
+#define POOL_WIDTH 32 // lanes per block, 32 bytes fills an AVX2 register
+
+typedef uint8_t pool_u8 __attribute__((vector_size(POOL_WIDTH)));
+typedef int8_t pool_m8 __attribute__((vector_size(POOL_WIDTH)));
+typedef uint16_t pool_u16 __attribute__((vector_size(POOL_WIDTH * 2)));
+typedef int16_t pool_m16 __attribute__((vector_size(POOL_WIDTH * 2)));
+typedef int64_t pool_i64 __attribute__((vector_size(POOL_WIDTH * 8)));
+typedef int64_t pool_m64 __attribute__((vector_size(POOL_WIDTH * 8)));
+
+typedef struct machine_pool {
+	int lanes;
+	int blocks;
+	// registers, same fields as machine, one vector per block
+	pool_u8* A;
+	pool_u8* X;
+	pool_u8* Y;
+	pool_u8* P;
+	pool_u8* S;
+	pool_u16* pc;
+	pool_i64* cycle;
+	// one machine per lane for memory, its registers are only current after pool_spill
+	machine* lane;
+	long wide_steps; // lane instructions run on the vector path
+	long scalar_steps; // lane instructions run one lane at a time
+} machine_pool;
+
+machine_pool* pool_create(machine* proto, int lanes);
+void pool_destroy(machine_pool* pool);
+machine* pool_spill(machine_pool* pool, int lane);
+void pool_fill(machine_pool* pool, int lane);
+void pool_step(machine_pool* pool);
+void pool_run(machine_pool* pool, long steps);
+
+#endif
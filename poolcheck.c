@@ -0,0 +1,105 @@
+/*
+* make check: run lanes of a machine_pool and the same machines one at a
+* time through run_cpu, and compare where they end up. The rom is built in
+* memory, a loop whose branches depend on X so the lanes split and meet
+* again, storing to ram on the way. Most of it is register only, so most
+* steps should run wide; fewer than MIN_WIDE of them means lanes on the
+* same pc stopped being run together.
+*/
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "machine.h"
+#include "io.h"
+#include "cpu.h"
+#include "pool.h"
+
+#define LANES 40 // more than a block, so the padding lanes are exercised too
+#define STEPS 20000
+#define MIN_WIDE 4 // at least a quarter of the steps run wide
+
+static const uint8_t program[] = {
+	0x8A, // loop: txa
+	0x18, // clc
+	0x69, 0x07, // adc #7
+	0xAA, // tax
+	0x29, 0x03, // and #3
+	0xD0, 0x01, // bne skip
+	0xC8, // iny
+	0x9D, 0x00, 0x03, // skip: sta $0300,x
+	0x4C, 0x00, 0xC0, // jmp loop
+};
+
+/* A one bank nrom image with program at 0xC000, built in memory */
+static machine* load(void)
+{
+	static uint8_t rom[16 + 0x4000];
+	machine* mch = NULL;
+	FILE* fp;
+
+	memcpy(rom, "NES\x1A\x01\x00", 6);
+	memcpy(rom + 16, program, sizeof(program));
+	rom[16 + 0x3FFC] = 0x00;
+	rom[16 + 0x3FFD] = 0xC0;
+
+	fp = fmemopen(rom, sizeof(rom), "rb");
+	if (!fp || read_ines(fp, &mch) != INES_OK) {
+		fprintf(stderr, "Could not build the rom.\n");
+		exit(-1);
+	}
+	fclose(fp);
+	power_on(mch);
+	return mch;
+}
+
+int main(void)
+{
+	machine* proto = load();
+	machine_pool* pool = pool_create(proto, LANES);
+	int bad = 0;
+	int i;
+
+	if (!pool) {
+		fprintf(stderr, "Could not allocate memory.\n");
+		return 2;
+	}
+
+	// start every lane somewhere else
+	for (i = 0; i < LANES; i++) {
+		machine* lane = pool_spill(pool, i);
+		lane->cpu.X = i;
+		pool_fill(pool, i);
+	}
+	pool_run(pool, STEPS);
+
+	for (i = 0; i < LANES; i++) {
+		machine* lane = pool_spill(pool, i);
+		machine* ref = load();
+
+		ref->cpu.X = i;
+		run_cpu(ref, lane->cpu.cycle);
+
+		if (ref->cpu.A != lane->cpu.A || ref->cpu.X != lane->cpu.X || ref->cpu.Y != lane->cpu.Y
+			|| ref->cpu.P != lane->cpu.P || ref->cpu.S != lane->cpu.S || ref->cpu.pc != lane->cpu.pc
+			|| ref->cpu.cycle != lane->cpu.cycle || memcmp(ref->memory, lane->memory, 2048) != 0) {
+			fprintf(stdout, "lane %d differs: pc %04x/%04x cycle %lld/%lld\n", i, lane->cpu.pc, ref->cpu.pc,
+				(long long) lane->cpu.cycle, (long long) ref->cpu.cycle);
+			bad++;
+		}
+		free(ref);
+	}
+
+	fprintf(stdout, "pool: %d of %d lanes match, %ld wide and %ld scalar steps\n", LANES - bad, LANES, pool->wide_steps, pool->scalar_steps);
+	if (pool->wide_steps * MIN_WIDE < pool->wide_steps + pool->scalar_steps) {
+		fprintf(stdout, "pool: fewer than 1 in %d steps ran wide\n", MIN_WIDE);
+		bad++;
+	}
+	if (pool_create(proto, 0) != NULL) {
+		fprintf(stdout, "pool: made a pool of 0 lanes\n");
+		bad++;
+	}
+	pool_destroy(pool);
+	free(proto);
+	return bad ? 1 : 0;
+}
@@ -0,0 +1,38 @@
+#include <stdint.h>
+#include <string.h>
+#include "machine.h"
+#include "ppu.h"
+#include "graphics.h"
+
+#define DMA_CYCLES 513
+
+/*
+* OAM DMA, started by writing a page number to 0x4014. The cpu is halted
+* while 256 bytes are copied from that page into oam starting at oam_addr,
+* so the whole copy is done at once and the stall charged in one step:
+* 513 cycles, plus one to line up on an even cycle if started on an odd one.
+*/
+void oam_dma(machine* mch, uint8_t page)
+{
+	uint8_t* src = mch->read_page[page];
+	uint8_t* oam = mch->ppu.oam;
+	uint8_t start = mch->ppu.oam_addr;
+	int i;
+
+	if (src) {
+		// the copy wraps around the end of oam unless oam_addr is 0
+		memcpy(oam + start, src, 256 - start);
+		memcpy(oam, src + 256 - start, start);
+	} else {
+		// registers or a watched page, go through the slow path a byte at a time
+		for (i = 0; i < 256; i++) {
+			oam[(uint8_t) (start + i)] = read_mem(mch, (uint16_t) (page << 8) | i);
+		}
+	}
+
+	if (mch->render) {
+		render_oam(mch->render, mch->cpu.cycle, oam);
+	}
+
+	mch->cpu.cycle += DMA_CYCLES + (mch->cpu.cycle & 1);
+}
@@ -0,0 +1,18 @@
+#ifndef PPU_H
+#define PPU_H
+
+#include <stdint.h>
+
+#define FRAME_DOTS 89342 // ppu dots in an ntsc frame, three per cpu cycle
+
+// ppu state that the cpu side can reach
+typedef struct ppu_state {
+	uint8_t oam[256]; // sprite memory, 64 sprites of 4 bytes
+	uint8_t oam_addr; // 0x2003
+} ppu_state;
+
+struct machine;
+
+void oam_dma(struct machine* mch, uint8_t page);
+
+#endif
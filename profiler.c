@@ -0,0 +1,116 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include "machine.h"
+#include "profiler.h"
+
+#define JSR_OPCODE 0x20
+
+/*
+* Allocate a profiler that keeps the last capacity samples, one every
+* period cycles. Returns NULL if capacity is over PROF_MAX_CAPACITY or out
+* of memory.
+*/
+profiler* profiler_create(uint32_t capacity, int period)
+{
+	uint32_t size = 1;
+
+	// any more and rounding up below would never end
+	if (capacity > PROF_MAX_CAPACITY) {
+		return NULL;
+	}
+
+	// round up so the ring index is a mask instead of a modulo
+	while (size < capacity) {
+		size <<= 1;
+	}
+
+	profiler* prof = (profiler*) malloc(sizeof(profiler));
+	if (!prof) {
+		return NULL;
+	}
+
+	prof->samples = (prof_sample*) calloc(size, sizeof(prof_sample));
+	if (!prof->samples) {
+		free(prof);
+		return NULL;
+	}
+
+	prof->mask = size - 1;
+	prof->count = 0;
+	prof->period = period > 0 ? period : 1;
+	prof->next_sample = prof->period;
+	return prof;
+}
+
+void profiler_destroy(profiler* prof)
+{
+	if (prof) {
+		free(prof->samples);
+		free(prof);
+	}
+}
+
+/*
+* Record the pc and the call chain. The 6502 has no frame pointers, so the
+* chain is rebuilt by walking page 1 from S upwards and keeping every byte
+* pair that points just past a JSR. Data pushed with PHA can fake a frame,
+* which is fine for a statistical profile.
+*/
+void profiler_sample(profiler* prof, machine* mch)
+{
+	prof_sample* s = &prof->samples[prof->count & prof->mask];
+	uint16_t i = (uint16_t) mch->cpu.S + 1;
+
+	s->cycle = mch->cpu.cycle;
+	s->pc = mch->cpu.pc;
+	s->depth = 0;
+
+	while (i < 0xFF && s->depth < PROF_MAX_DEPTH) {
+		uint16_t ret = peek_mem(mch, 0x0100 + i) | ((uint16_t) peek_mem(mch, 0x0100 + i + 1) << 8);
+		// JSR pushes the address of its own last byte
+		uint16_t call = ret - 2;
+
+		if (peek_mem(mch, call) == JSR_OPCODE) {
+			s->calls[s->depth++] = call;
+			i += 2;
+		} else {
+			i += 1;
+		}
+	}
+
+	prof->count++;
+
+	// catch up in one step if a long instruction or a stall skipped periods
+	do {
+		prof->next_sample += prof->period;
+	} while (prof->next_sample <= mch->cpu.cycle);
+}
+
+/* Write the ring buffer out oldest sample first. Returns 0 on success. */
+int profiler_dump(profiler* prof, FILE* fp)
+{
+	prof_header header;
+	uint32_t capacity = prof->mask + 1;
+	uint32_t kept = prof->count < capacity ? (uint32_t) prof->count : capacity;
+	uint64_t first = prof->count - kept;
+	uint32_t i;
+
+	header.magic = PROF_MAGIC;
+	header.period = prof->period;
+	header.count = prof->count;
+	header.kept = kept;
+	header.unused = 0;
+
+	if (fwrite(&header, sizeof(header), 1, fp) != 1) {
+		return -1;
+	}
+
+	for (i = 0; i < kept; i++) {
+		if (fwrite(&prof->samples[(first + i) & prof->mask], sizeof(prof_sample), 1, fp) != 1) {
+			return -1;
+		}
+	}
+
+	return 0;
+}
@@ -0,0 +1,51 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include "machine.h"
+
+#define PROF_MAGIC 0x33465250 // "PRF3", 64 bit cycle stamps and sample count
+#define PROF_MAX_DEPTH 8 // deepest call chain kept per sample
+#define PROF_MAX_CAPACITY (1u << 31) // largest ring, a power of two that fits the mask
+
+// one sample: where the cpu was and who called it, innermost caller first
+typedef struct prof_sample {
+	int64_t cycle;
+	uint16_t pc;
+	uint16_t depth;
+	uint16_t calls[PROF_MAX_DEPTH]; // addresses of the JSRs on the stack
+} prof_sample;
+
+// sampling profiler, samples go into a ring buffer allocated up front
+typedef struct profiler {
+	prof_sample* samples;
+	uint32_t mask; // capacity - 1, capacity is a power of two
+	uint64_t count; // samples taken so far, wraps over the ring
+	int period; // emulated cycles between samples
+	int64_t next_sample; // cycle at which the next sample is due
+} profiler;
+
+// header of a sample dump, followed by min(count, capacity) samples
+typedef struct prof_header {
+	uint32_t magic;
+	uint32_t period;
+	uint64_t count;
+	uint32_t kept;
+	uint32_t unused; // zero, keeps the size the same on every abi
+} prof_header;
+
+profiler* profiler_create(uint32_t capacity, int period);
+void profiler_destroy(profiler* prof);
+void profiler_sample(profiler* prof, machine* mch);
+int profiler_dump(profiler* prof, FILE* fp);
+
+/* Called once per instruction, only samples when the deadline has passed */
+static inline void profiler_tick(profiler* prof, machine* mch)
+{
+	if (mch->cpu.cycle >= prof->next_sample) {
+		profiler_sample(prof, mch);
+	}
+}
+
+#endif
@@ -0,0 +1,258 @@
+/*
+* profsym - symbolize a sample dump written by the profiler.
+*
+* usage: profsym [-c] samples.prof labels
+*
+* labels is either a VICE label file from ld65 -Ln ("al 00C000 .reset")
+* or a cc65 debug info file from ld65 --dbgfile (sym lines with name= and val=).
+* Prints a flat profile by default, or collapsed stacks with -c that can be
+* fed straight to flamegraph.pl.
+*/
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "machine.h"
+#include "profiler.h"
+
+#define MAX_NAME 64
+
+typedef struct label {
+	uint16_t address;
+	char name[MAX_NAME];
+} label;
+
+typedef struct symbol_count {
+	const char* name;
+	uint32_t samples;
+} symbol_count;
+
+static label* labels = NULL;
+static int num_labels = 0;
+static int max_labels = 0;
+
+static void add_label(uint16_t address, const char* name, size_t len)
+{
+	if (num_labels == max_labels) {
+		max_labels = max_labels ? max_labels * 2 : 256;
+		labels = (label*) realloc(labels, max_labels * sizeof(label));
+		if (!labels) {
+			fprintf(stderr, "Could not allocate memory!\n");
+			exit(-1);
+		}
+	}
+
+	if (len >= MAX_NAME) {
+		len = MAX_NAME - 1;
+	}
+
+	labels[num_labels].address = address;
+	memcpy(labels[num_labels].name, name, len);
+	labels[num_labels].name[len] = '\0';
+	num_labels++;
+}
+
+/* Parse a single "sym" line from a cc65 debug info file */
+static void parse_dbg_sym(const char* line)
+{
+	const char* name = strstr(line, "name=\"");
+	const char* val = strstr(line, "val=");
+	const char* end;
+
+	// only labels have an address worth symbolizing
+	if (!name || !val || !strstr(line, "type=lab")) {
+		return;
+	}
+
+	name += 6;
+	end = strchr(name, '"');
+	if (!end) {
+		return;
+	}
+
+	add_label((uint16_t) strtoul(val + 4, NULL, 0), name, end - name);
+}
+
+/* Parse a single "al" line from a VICE label file */
+static void parse_vice_label(const char* line)
+{
+	char* end;
+	unsigned long address = strtoul(line + 3, &end, 16);
+	size_t len;
+
+	while (*end == ' ') {
+		end++;
+	}
+	// VICE prefixes every label with a dot
+	if (*end == '.') {
+		end++;
+	}
+
+	len = strcspn(end, "\r\n");
+	if (len > 0) {
+		add_label((uint16_t) address, end, len);
+	}
+}
+
+static int compare_labels(const void* a, const void* b)
+{
+	return (int) ((const label*) a)->address - (int) ((const label*) b)->address;
+}
+
+static void read_labels(FILE* fp)
+{
+	char line[1024];
+
+	while (fgets(line, sizeof(line), fp)) {
+		if (strncmp(line, "al ", 3) == 0) {
+			parse_vice_label(line);
+		} else if (strncmp(line, "sym\t", 4) == 0) {
+			parse_dbg_sym(line);
+		}
+	}
+
+	qsort(labels, num_labels, sizeof(label), compare_labels);
+}
+
+/* Find the closest label at or below address */
+static const char* symbolize(uint16_t address)
+{
+	int lo = 0, hi = num_labels - 1, best = -1;
+
+	while (lo <= hi) {
+		int mid = (lo + hi) / 2;
+		if (labels[mid].address <= address) {
+			best = mid;
+			lo = mid + 1;
+		} else {
+			hi = mid - 1;
+		}
+	}
+
+	return best < 0 ? "??" : labels[best].name;
+}
+
+static int compare_counts(const void* a, const void* b)
+{
+	uint32_t x = ((const symbol_count*) a)->samples;
+	uint32_t y = ((const symbol_count*) b)->samples;
+	return x < y ? 1 : (x > y ? -1 : 0);
+}
+
+/* Self samples per symbol, busiest first */
+static void print_flat(prof_sample* samples, uint32_t kept)
+{
+	symbol_count* counts = (symbol_count*) calloc(num_labels + 1, sizeof(symbol_count));
+	int num_counts = 0;
+	uint32_t i;
+	int j;
+
+	if (!counts) {
+		fprintf(stderr, "Could not allocate memory!\n");
+		exit(-1);
+	}
+
+	for (i = 0; i < kept; i++) {
+		const char* name = symbolize(samples[i].pc);
+		for (j = 0; j < num_counts; j++) {
+			if (counts[j].name == name) {
+				break;
+			}
+		}
+		if (j == num_counts) {
+			counts[num_counts++].name = name;
+		}
+		counts[j].samples++;
+	}
+
+	qsort(counts, num_counts, sizeof(symbol_count), compare_counts);
+
+	for (j = 0; j < num_counts; j++) {
+		fprintf(stdout, "%6.2f%% %8u  %s\n", 100.0 * counts[j].samples / kept, counts[j].samples, counts[j].name);
+	}
+
+	free(counts);
+}
+
+/* One line per sample, outermost frame first, in the collapsed stack format */
+static void print_collapsed(prof_sample* samples, uint32_t kept)
+{
+	uint32_t i;
+	int j;
+
+	for (i = 0; i < kept; i++) {
+		for (j = samples[i].depth - 1; j >= 0; j--) {
+			fprintf(stdout, "%s;", symbolize(samples[i].calls[j]));
+		}
+		fprintf(stdout, "%s 1\n", symbolize(samples[i].pc));
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	int collapsed = 0;
+	prof_header header;
+	prof_sample* samples;
+	FILE* fp;
+
+	if (argc > 1 && strcmp(argv[1], "-c") == 0) {
+		collapsed = 1;
+		argv++;
+		argc--;
+	}
+
+	if (argc != 3) {
+		fprintf(stderr, "usage: profsym [-c] samples.prof labels\n");
+		exit(-1);
+	}
+
+	fp = fopen(argv[2], "r");
+	if (fp == NULL) {
+		fprintf(stderr, "Could not open file '%s'. Exiting.\n", argv[2]);
+		exit(-1);
+	}
+	read_labels(fp);
+	fclose(fp);
+
+	fp = fopen(argv[1], "rb");
+	if (fp == NULL) {
+		fprintf(stderr, "Could not open file '%s'. Exiting.\n", argv[1]);
+		exit(-1);
+	}
+
+	if (fread(&header, sizeof(header), 1, fp) != 1 || header.magic != PROF_MAGIC) {
+		fprintf(stderr, "'%s' is not a sample dump. Exiting.\n", argv[1]);
+		exit(-1);
+	}
+
+	// a ring is never bigger than PROF_MAX_CAPACITY, nor keeps more than it took
+	if (header.kept > PROF_MAX_CAPACITY || header.kept > header.count) {
+		fprintf(stderr, "Sample dump '%s' has a bad header. Exiting.\n", argv[1]);
+		exit(-1);
+	}
+
+	samples = (prof_sample*) malloc(((size_t) header.kept + 1) * sizeof(prof_sample));
+	if (!samples) {
+		fprintf(stderr, "Could not allocate memory!\n");
+		exit(-1);
+	}
+
+	if (fread(samples, sizeof(prof_sample), header.kept, fp) != header.kept) {
+		fprintf(stderr, "Sample dump '%s' is truncated. Exiting.\n", argv[1]);
+		exit(-1);
+	}
+	fclose(fp);
+
+	if (header.kept == 0) {
+		fprintf(stderr, "No samples in '%s'.\n", argv[1]);
+	} else if (collapsed) {
+		print_collapsed(samples, header.kept);
+	} else {
+		fprintf(stdout, "%u samples kept of %llu, one every %u cycles\n", header.kept, (unsigned long long) header.count, header.period);
+		print_flat(samples, header.kept);
+	}
+
+	free(samples);
+	free(labels);
+	return 0;
+}
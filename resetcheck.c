@@ -0,0 +1,123 @@
+/*
+* make check: reset a machine with a renderer and the audio attached, and
+* make sure both carry on from the new cycle 0 instead of the old clock,
+* and that injected input survives. The rom is built in memory, a square
+* wave on the dac at 0x4011.
+*/
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "machine.h"
+#include "io.h"
+#include "cpu.h"
+#include "ppu.h"
+#include "arena.h"
+#include "graphics.h"
+#include "sound.h"
+#include "input.h"
+
+#define RATE 44100
+#define FRAMES 10 // a run each side of the reset
+#define CYCLES (FRAMES * FRAME_DOTS / 3 + 100)
+
+static const uint8_t program[] = {
+	0xA9, 0x7F, // loop: lda #$7f
+	0x8D, 0x11, 0x40, // sta $4011
+	0xA9, 0x00, // lda #0
+	0x8D, 0x11, 0x40, // sta $4011
+	0x4C, 0x00, 0xC0, // jmp loop
+};
+
+/* A one bank nrom image with program at 0xC000, built in memory */
+static machine* load(void)
+{
+	static uint8_t rom[16 + 0x4000];
+	machine* mch = NULL;
+	FILE* fp;
+
+	memcpy(rom, "NES\x1A\x01\x00", 6);
+	memcpy(rom + 16, program, sizeof(program));
+	rom[16 + 0x3FFC] = 0x00;
+	rom[16 + 0x3FFD] = 0xC0;
+
+	fp = fmemopen(rom, sizeof(rom), "rb");
+	if (!fp || read_ines(fp, &mch) != INES_OK) {
+		fprintf(stderr, "Could not build the rom.\n");
+		exit(-1);
+	}
+	fclose(fp);
+	power_on(mch);
+	return mch;
+}
+
+/* The frame_sink, counting frames */
+static void count_frame(void* ctx, const uint32_t* pixels, int64_t frame)
+{
+	(void) pixels;
+	(void) frame;
+	(*(int*) ctx)++;
+}
+
+/* Run, reset and run again. Returns 0 if the frames and samples add up. */
+static int check(char threaded)
+{
+	machine* mch = load();
+	renderer* render = render_create(mch, threaded);
+	audio_out* audio = audio_create(mch, RATE, 0, 0, null_sink, NULL);
+	int64_t expected = (int64_t) RATE * 2 * CYCLES / CPU_RATE + BLIP_TAPS;
+	int frames = 0;
+	int bad;
+
+	if (!render || !audio) {
+		fprintf(stderr, "Could not allocate memory.\n");
+		exit(2);
+	}
+	render_add_sink(render, count_frame, &frames);
+
+	run_cpu(mch, CYCLES);
+	arena_reset(mch);
+	run_cpu(mch, CYCLES);
+
+	render_finish(render);
+	audio_finish(audio);
+	bad = frames != 2 * FRAMES || audio->samples < expected - 2 || audio->samples > expected + 2;
+	if (bad) {
+		fprintf(stdout, "reset%s: %d frames of %d, %lld samples of %lld\n", threaded ? ", threaded" : "",
+			frames, 2 * FRAMES, (long long) audio->samples, (long long) expected);
+	}
+
+	mch->render = NULL;
+	mch->audio = NULL;
+	render_destroy(render);
+	audio_destroy(audio);
+	free(mch);
+	return bad;
+}
+
+/* Returns 0 if the injected input is still there after a reset, from the top */
+static int check_input(void)
+{
+	static const uint8_t frames[] = {0x01, 0x00, 0x80, 0x00};
+	machine* mch = load();
+	int bad;
+
+	input_inject(mch, frames, 2);
+	input_next_frame(mch);
+	arena_reset(mch);
+	bad = mch->input != frames || mch->input_frames != 2 || mch->input_frame != 0;
+	if (bad) {
+		fprintf(stdout, "reset: input dropped\n");
+	}
+
+	free(mch);
+	return bad;
+}
+
+int main(void)
+{
+	int bad = check(0) + check(1) + check_input();
+
+	fprintf(stdout, "reset: %s\n", bad ? "state lost" : "renderer, audio and input start again at cycle 0");
+	return bad ? 1 : 0;
+}
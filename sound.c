@@ -1,5 +1,12 @@
 #include <stdio.h>
 #include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "machine.h"
+#include "sound.h"
+
+#define CUTOFF 0.45 // of the output rate, just under nyquist
 
 void emulate_sound(uint8_t* memory)
 {
@@ -10,4 +17,276 @@ void emulate_sound(uint8_t* memory)
 			fprintf(stdout,"Address %x on APU\n", memory[i]);
 		}
 	}
-}
\ No newline at end of file
+}
+
+/*
+* The step kernel: a blackman windowed sinc, sampled at each phase and
+* rounded so every phase sums to exactly 1 << BLIP_BITS. Summing the
+* buffer out then turns each step into a band limited edge.
+*/
+static void make_kernel(audio_out* a)
+{
+	int p, j;
+
+	for (p = 0; p < BLIP_PHASES; p++) {
+		double taps[BLIP_TAPS], total = 0;
+		int sum = 0, peak = 0;
+
+		for (j = 0; j < BLIP_TAPS; j++) {
+			double x = j - BLIP_TAPS / 2 + 1 - (double) p / BLIP_PHASES;
+			double w = 0.42 + 0.5 * cos(M_PI * x / (BLIP_TAPS / 2)) + 0.08 * cos(2 * M_PI * x / (BLIP_TAPS / 2));
+			double s = x == 0 ? 2 * CUTOFF : sin(2 * M_PI * CUTOFF * x) / (M_PI * x);
+			taps[j] = fabs(x) < BLIP_TAPS / 2 ? s * w : 0;
+			total += taps[j];
+		}
+
+		for (j = 0; j < BLIP_TAPS; j++) {
+			a->kernel[p][j] = (int16_t) lround(taps[j] / total * (1 << BLIP_BITS));
+			sum += a->kernel[p][j];
+			if (a->kernel[p][j] > a->kernel[p][peak]) {
+				peak = j;
+			}
+		}
+		a->kernel[p][peak] += (1 << BLIP_BITS) - sum;
+	}
+}
+
+/* Hand the block to the sink, unless it already failed */
+static void flush_block(audio_out* a)
+{
+	if (a->block_fill && !a->error && a->sink(a->sink_ctx, a->block, a->block_fill) != 0) {
+		a->error = 1;
+	}
+	a->samples += a->block_fill;
+	a->block_fill = 0;
+}
+
+/* Sum count samples out of the front of the buffer, count at most size */
+static void read_samples(audio_out* a, int count)
+{
+	int64_t sum = a->sum;
+	int i;
+
+	for (i = 0; i < count; i++) {
+		int64_t out = sum >> BLIP_BITS;
+		sum += a->deltas[i];
+		sum -= out * (1 << (BLIP_BITS - BASS_SHIFT)); // out may be negative, so no shift
+		a->block[a->block_fill++] = out > INT16_MAX ? INT16_MAX : out < INT16_MIN ? INT16_MIN : (int16_t) out;
+		if (a->block_fill == a->block_size) {
+			flush_block(a);
+		}
+	}
+	a->sum = sum;
+
+	memmove(a->deltas, a->deltas + count, (a->size + BLIP_TAPS - count) * sizeof(int32_t));
+	memset(a->deltas + a->size + BLIP_TAPS - count, 0, count * sizeof(int32_t));
+	a->pos -= (uint64_t) count << 32;
+}
+
+/*
+* Start resampling to rate samples a second, handing blocks of latency_ms
+* to sink. size is how many output samples the buffer holds between two
+* reads, 0 for a frame's worth; a cpu run longer than that is read out on
+* the way. Returns NULL if out of memory.
+*/
+audio_out* audio_create(machine* mch, int rate, int latency_ms, int size, audio_sink sink, void* ctx)
+{
+	audio_out* a = (audio_out*) calloc(1, sizeof(audio_out));
+
+	if (!a) {
+		return NULL;
+	}
+
+	a->rate = rate;
+	a->step = (((uint64_t) rate << 32) + CPU_RATE / 2) / CPU_RATE;
+	a->cycle = mch->cpu.cycle;
+	a->size = size > 0 ? size : rate / 60 + 1;
+	a->block_size = latency_ms > 0 ? (int) ((int64_t) rate * latency_ms / 1000) : 1;
+	if (a->block_size < 1) {
+		a->block_size = 1;
+	}
+	a->sink = sink;
+	a->sink_ctx = ctx;
+	make_kernel(a);
+
+	a->deltas = (int32_t*) calloc(a->size + BLIP_TAPS, sizeof(int32_t));
+	a->block = (int16_t*) malloc(a->block_size * sizeof(int16_t));
+	if (!a->deltas || !a->block) {
+		audio_destroy(a);
+		return NULL;
+	}
+
+	mch->audio = a;
+	return a;
+}
+
+/* Read out every sample that ends before cycle */
+void audio_sync(audio_out* a, int64_t cycle)
+{
+	a->pos += (uint64_t) (cycle - a->cycle) * a->step;
+	a->cycle = cycle;
+
+	while ((a->pos >> 32) > 0) {
+		uint64_t count = a->pos >> 32;
+		read_samples(a, count > (uint64_t) a->size ? a->size : (int) count);
+	}
+}
+
+/* The output level changed to level at cycle, not before the last one */
+void audio_level(audio_out* a, int64_t cycle, int level)
+{
+	uint64_t pos = a->pos + (uint64_t) (cycle - a->cycle) * a->step;
+	int delta = (level - a->level) * DAC_VOLUME;
+	const int16_t* kernel;
+	int32_t* out;
+	int j;
+
+	if (delta == 0) {
+		return;
+	}
+	a->level = level;
+
+	if ((pos >> 32) >= (uint64_t) a->size) {
+		audio_sync(a, cycle);
+		pos = a->pos;
+	}
+
+	kernel = a->kernel[(pos >> (32 - BLIP_PHASE_BITS)) & (BLIP_PHASES - 1)];
+	out = &a->deltas[pos >> 32];
+	for (j = 0; j < BLIP_TAPS; j++) {
+		out[j] += delta * kernel[j];
+	}
+}
+
+/*
+* The machine was reset and its clock starts again at cycle, with the dac
+* back at 0. Everything before the reset has to be synced already.
+*/
+void audio_reset(audio_out* a, int64_t cycle)
+{
+	a->cycle = cycle;
+	audio_level(a, cycle, 0);
+}
+
+/*
+* Read out the tail of the last steps, which reaches BLIP_TAPS samples
+* past the last sync, and hand the last partial block over. Returns 0, or
+* -1 if the sink failed.
+*/
+int audio_finish(audio_out* a)
+{
+	int tail = BLIP_TAPS < a->size ? BLIP_TAPS : a->size;
+
+	a->pos += (uint64_t) tail << 32;
+	read_samples(a, tail);
+	flush_block(a);
+	return a->error ? -1 : 0;
+}
+
+void audio_destroy(audio_out* a)
+{
+	if (a) {
+		free(a->deltas);
+		free(a->block);
+		free(a);
+	}
+}
+
+static void put16le(uint8_t* out, uint16_t value)
+{
+	out[0] = value & 0xFF;
+	out[1] = value >> 8;
+}
+
+static void put32le(uint8_t* out, uint32_t value)
+{
+	put16le(out, value & 0xFFFF);
+	put16le(out + 2, value >> 16);
+}
+
+/* The 44 byte header of a 16 bit mono pcm wav with bytes of samples */
+static int wav_header(wav_file* wav, uint32_t bytes)
+{
+	uint8_t header[44];
+
+	memcpy(header, "RIFF", 4);
+	put32le(header + 4, 36 + bytes);
+	memcpy(header + 8, "WAVEfmt ", 8);
+	put32le(header + 16, 16);
+	put16le(header + 20, 1); // pcm
+	put16le(header + 22, 1); // mono
+	put32le(header + 24, wav->rate);
+	put32le(header + 28, wav->rate * 2);
+	put16le(header + 32, 2);
+	put16le(header + 34, 16);
+	memcpy(header + 36, "data", 4);
+	put32le(header + 40, bytes);
+
+	return fwrite(header, 1, 44, wav->fp) == 44 ? 0 : -1;
+}
+
+/* Start a wav file on fp. Returns 0 on success. */
+int wav_open(wav_file* wav, FILE* fp, int rate)
+{
+	wav->fp = fp;
+	wav->rate = rate;
+	wav->bytes = 0;
+	return wav_header(wav, 0);
+}
+
+/* The audio_sink for a wav_file */
+int wav_sink(void* ctx, const int16_t* samples, int count)
+{
+	wav_file* wav = (wav_file*) ctx;
+
+	if (raw_sink(wav->fp, samples, count) != 0) {
+		return -1;
+	}
+	wav->bytes += count * 2;
+	return 0;
+}
+
+/*
+* Fill in the sizes left open by wav_open. Returns 0 on success; a file
+* that cannot seek, like a pipe, keeps the open sizes most players accept.
+*/
+int wav_close(wav_file* wav)
+{
+	if (fflush(wav->fp) != 0) {
+		return -1;
+	}
+	if (fseek(wav->fp, 0, SEEK_SET) != 0) {
+		return 0;
+	}
+	return wav_header(wav, wav->bytes) == 0 && fflush(wav->fp) == 0 ? 0 : -1;
+}
+
+/* The audio_sink for a FILE*, little endian samples with no header */
+int raw_sink(void* ctx, const int16_t* samples, int count)
+{
+	FILE* fp = (FILE*) ctx;
+	uint8_t bytes[512];
+	int i, n;
+
+	while (count > 0) {
+		n = count < 256 ? count : 256;
+		for (i = 0; i < n; i++) {
+			put16le(&bytes[i * 2], (uint16_t) samples[i]);
+		}
+		if (fwrite(bytes, 2, n, fp) != (size_t) n) {
+			return -1;
+		}
+		samples += n;
+		count -= n;
+	}
+	return 0;
+}
+
+/* The audio_sink that drops everything, to time the audio path alone */
+int null_sink(void* ctx, const int16_t* samples, int count)
+{
+	(void) ctx;
+	(void) samples;
+	(void) count;
+	return 0;
+}
@@ -1,6 +1,74 @@
 #ifndef SOUND_H
 #define SOUND_H
 
+#include <stdio.h>
+#include <stdint.h>
+#include "machine.h"
+
+#define CPU_RATE 1789773 // ntsc cpu cycles a second, the rate levels change at
+#define BLIP_PHASE_BITS 5
+#define BLIP_PHASES (1 << BLIP_PHASE_BITS) // positions between two output samples a step can start at
+#define BLIP_TAPS 16 // output samples each step is spread over
+#define BLIP_BITS 15 // fraction bits of the step kernel
+#define BASS_SHIFT 9 // dc blocking, about 14 Hz at 44.1 kHz
+#define DAC_VOLUME 128 // output per step of the 7 bit dac at 0x4011
+
+/*
+* Called with every block of finished samples, 16 bit signed mono at the
+* output rate. samples only stay valid until the call returns. Returns 0,
+* or -1 to drop the rest of the audio.
+*/
+typedef int (*audio_sink)(void* ctx, const int16_t* samples, int count);
+
+/*
+* Band limited resampling from the cpu clock down to the output rate, in
+* the style of a blip buffer: every change of level is added into the
+* buffer as a windowed sinc step at the cycle it happened, so a run of
+* cycles with no change costs nothing, and samples are only summed out in
+* blocks when the cpu stops. The sink sees a block once latency worth of
+* samples is ready.
+*/
+typedef struct audio_out {
+	int rate; // output samples a second
+	uint64_t step; // output samples per cycle, 32.32 fixed point
+	int64_t cycle; // cycle the buffer is synced to
+	uint64_t pos; // where cycle falls in the buffer, 32.32 fixed point
+	int level; // last level, steps are the difference to it
+	int64_t sum; // integrator, the output before BLIP_BITS are shifted off
+	int64_t samples; // handed to the sink so far
+
+	audio_sink sink;
+	void* sink_ctx;
+	int error; // the sink failed, later blocks are dropped
+
+	int16_t kernel[BLIP_PHASES][BLIP_TAPS];
+	int32_t* deltas; // buffer of size + BLIP_TAPS steps
+	int size; // output samples the buffer holds before it has to be read
+	int16_t* block;
+	int block_size; // samples per sink call, the latency
+	int block_fill;
+} audio_out;
+
+// a wav file being written, see wav_sink
+typedef struct wav_file {
+	FILE* fp;
+	int rate;
+	uint32_t bytes; // sample data so far
+} wav_file;
+
+audio_out* audio_create(machine* mch, int rate, int latency_ms, int size, audio_sink sink, void* ctx);
+void audio_level(audio_out* a, int64_t cycle, int level);
+void audio_sync(audio_out* a, int64_t cycle);
+void audio_reset(audio_out* a, int64_t cycle);
+int audio_finish(audio_out* a);
+void audio_destroy(audio_out* a);
+
+int wav_open(wav_file* wav, FILE* fp, int rate);
+int wav_sink(void* ctx, const int16_t* samples, int count);
+int wav_close(wav_file* wav);
+int raw_sink(void* ctx, const int16_t* samples, int count);
+int null_sink(void* ctx, const int16_t* samples, int count);
+
 void emulate_sound(uint8_t* memory);
 
-#endif
\ No newline at end of file
+#endif
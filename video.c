@@ -0,0 +1,322 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "graphics.h"
+#include "video.h"
+
+#define MAX_PATH 4096
+#define STORED_BLOCK 65535 // largest uncompressed deflate block
+
+static uint32_t crc_table[256];
+static pthread_once_t crc_once = PTHREAD_ONCE_INIT;
+
+static void crc_init(void)
+{
+	uint32_t i, j;
+
+	for (i = 0; i < 256; i++) {
+		uint32_t c = i;
+		for (j = 0; j < 8; j++) {
+			c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+		}
+		crc_table[i] = c;
+	}
+}
+
+static uint32_t crc_update(uint32_t crc, const uint8_t* data, size_t length)
+{
+	while (length--) {
+		crc = crc_table[(crc ^ *data++) & 0xFF] ^ (crc >> 8);
+	}
+	return crc;
+}
+
+static void put32(uint8_t* out, uint32_t value)
+{
+	out[0] = value >> 24;
+	out[1] = value >> 16;
+	out[2] = value >> 8;
+	out[3] = value;
+}
+
+/* A png chunk, with its length and crc around data */
+static int png_chunk(FILE* fp, const char* type, const uint8_t* data, uint32_t length)
+{
+	uint8_t head[8], tail[4];
+	uint32_t crc;
+
+	put32(head, length);
+	memcpy(head + 4, type, 4);
+	crc = crc_update(0xFFFFFFFFu, head + 4, 4);
+	crc = crc_update(crc, data, length) ^ 0xFFFFFFFFu;
+	put32(tail, crc);
+
+	if (fwrite(head, 1, 8, fp) != 8 || fwrite(data, 1, length, fp) != length || fwrite(tail, 1, 4, fp) != 4) {
+		return -1;
+	}
+	return 0;
+}
+
+// the zlib stream of a png being built, see stored_byte
+typedef struct stored {
+	uint8_t* out;
+	size_t done; // image bytes so far
+	size_t raw; // image bytes in all
+	uint32_t a, b; // adler32
+} stored;
+
+/* Append one byte of image data, starting a new stored block every 64KB */
+static void stored_byte(stored* s, uint8_t byte)
+{
+	if (s->done % STORED_BLOCK == 0) {
+		size_t left = s->raw - s->done < STORED_BLOCK ? s->raw - s->done : STORED_BLOCK;
+		*s->out++ = s->done + left == s->raw; // last block
+		*s->out++ = left & 0xFF;
+		*s->out++ = left >> 8;
+		*s->out++ = ~left & 0xFF;
+		*s->out++ = (~left >> 8) & 0xFF;
+	}
+	*s->out++ = byte;
+	s->a = (s->a + byte) % 65521;
+	s->b = (s->b + s->a) % 65521;
+	s->done++;
+}
+
+/*
+* Write rgba pixels as a png. The image data goes into stored deflate
+* blocks, not compressed, so this needs no zlib and costs no more than a
+* copy; compress the snapshots afterwards if they are kept. Returns 0 on
+* success.
+*/
+int png_write(FILE* fp, const uint32_t* pixels, int width, int height)
+{
+	static const uint8_t signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+	size_t row = 1 + (size_t) width * 4, raw = row * height;
+	size_t blocks = (raw + STORED_BLOCK - 1) / STORED_BLOCK;
+	size_t length = 2 + blocks * 5 + raw + 4;
+	uint8_t header[13];
+	uint8_t* data = (uint8_t*) malloc(length);
+	stored s = {data, 0, raw, 1, 0};
+	size_t i;
+	int y, result;
+
+	if (!data) {
+		return -1;
+	}
+
+	put32(header, width);
+	put32(header + 4, height);
+	header[8] = 8; // bits per channel
+	header[9] = 6; // rgba
+	header[10] = header[11] = header[12] = 0;
+
+	*s.out++ = 0x78; // deflate, 32KB window
+	*s.out++ = 0x01;
+	for (y = 0; y < height; y++) {
+		const uint8_t* scan = (const uint8_t*) &pixels[(size_t) y * width];
+		stored_byte(&s, 0); // no filter
+		for (i = 0; i < row - 1; i++) {
+			stored_byte(&s, scan[i]);
+		}
+	}
+	put32(s.out, (s.b << 16) | s.a);
+
+	pthread_once(&crc_once, crc_init);
+	result = fwrite(signature, 1, 8, fp) != 8
+		|| png_chunk(fp, "IHDR", header, 13) != 0
+		|| png_chunk(fp, "IDAT", data, (uint32_t) length) != 0
+		|| png_chunk(fp, "IEND", NULL, 0) != 0 ? -1 : 0;
+	free(data);
+	return result;
+}
+
+/* rgba to planar yuv 4:2:0, chroma from the average of each 2x2 block */
+static int write_yuv(video_out* out, const uint32_t* pixels)
+{
+	uint8_t* planes = out->planes;
+	uint8_t* y_plane = planes;
+	uint8_t* u_plane = planes + PPU_WIDTH * PPU_HEIGHT;
+	uint8_t* v_plane = u_plane + PPU_WIDTH * PPU_HEIGHT / 4;
+	int x, y;
+
+	for (y = 0; y < PPU_HEIGHT; y++) {
+		for (x = 0; x < PPU_WIDTH; x++) {
+			uint32_t p = pixels[y * PPU_WIDTH + x];
+			int r = p & 0xFF, g = (p >> 8) & 0xFF, b = (p >> 16) & 0xFF;
+			y_plane[y * PPU_WIDTH + x] = (uint8_t) (16 + ((66 * r + 129 * g + 25 * b + 128) >> 8));
+		}
+	}
+
+	for (y = 0; y < PPU_HEIGHT; y += 2) {
+		for (x = 0; x < PPU_WIDTH; x += 2) {
+			const uint32_t* p = &pixels[y * PPU_WIDTH + x];
+			uint32_t quad[4] = {p[0], p[1], p[PPU_WIDTH], p[PPU_WIDTH + 1]};
+			int r = 0, g = 0, b = 0, i, at = (y / 2) * (PPU_WIDTH / 2) + x / 2;
+			for (i = 0; i < 4; i++) {
+				r += quad[i] & 0xFF;
+				g += (quad[i] >> 8) & 0xFF;
+				b += (quad[i] >> 16) & 0xFF;
+			}
+			r /= 4;
+			g /= 4;
+			b /= 4;
+			u_plane[at] = (uint8_t) (128 + ((-38 * r - 74 * g + 112 * b + 128) >> 8));
+			v_plane[at] = (uint8_t) (128 + ((112 * r - 94 * g - 18 * b + 128) >> 8));
+		}
+	}
+
+	return fwrite(planes, 1, sizeof(out->planes), out->stream) == sizeof(out->planes) ? 0 : -1;
+}
+
+/* Everything that happens to one frame on the writer thread */
+static int write_frame(video_out* out, const uint32_t* pixels, int64_t number)
+{
+	if (out->stream) {
+		if (out->format == VIDEO_YUV) {
+			if (write_yuv(out, pixels) != 0) {
+				return -1;
+			}
+		} else if (fwrite(pixels, 4, PPU_WIDTH * PPU_HEIGHT, out->stream) != PPU_WIDTH * PPU_HEIGHT) {
+			return -1;
+		}
+	}
+
+	if (out->png_dir && number % out->png_every == 0) {
+		char path[MAX_PATH];
+		FILE* fp;
+		int result;
+
+		snprintf(path, sizeof(path), "%s/frame_%06lld.png", out->png_dir, (long long) number);
+		fp = fopen(path, "wb");
+		if (!fp) {
+			return -1;
+		}
+		result = png_write(fp, pixels, PPU_WIDTH, PPU_HEIGHT);
+		if (fclose(fp) != 0) {
+			result = -1;
+		}
+		return result;
+	}
+
+	return 0;
+}
+
+/* The writer thread, taking the buffers in turn */
+static void* video_thread(void* arg)
+{
+	video_out* out = (video_out*) arg;
+	int turn = 0;
+
+	for (;;) {
+		int error;
+
+		pthread_mutex_lock(&out->lock);
+		while (!out->full[turn] && !out->stop) {
+			pthread_cond_wait(&out->changed, &out->lock);
+		}
+		if (!out->full[turn]) {
+			pthread_mutex_unlock(&out->lock);
+			return NULL;
+		}
+		pthread_mutex_unlock(&out->lock);
+
+		error = out->error ? 0 : write_frame(out, out->pixels[turn], out->number[turn]);
+
+		pthread_mutex_lock(&out->lock);
+		if (error) {
+			out->error = 1;
+		}
+		out->full[turn] = 0;
+		pthread_cond_broadcast(&out->changed);
+		pthread_mutex_unlock(&out->lock);
+		turn ^= 1;
+	}
+}
+
+/*
+* Start writing frames to stream in format, and a png every png_every
+* frames into png_dir. Either can be left out with NULL. Returns NULL if
+* out of memory or the thread could not be started.
+*/
+video_out* video_open(FILE* stream, int format, const char* png_dir, int png_every)
+{
+	video_out* out = (video_out*) calloc(1, sizeof(video_out));
+
+	if (!out) {
+		return NULL;
+	}
+
+	out->stream = stream;
+	out->format = format;
+	out->png_dir = png_dir;
+	out->png_every = png_every > 0 ? png_every : 1;
+	pthread_mutex_init(&out->lock, NULL);
+	pthread_cond_init(&out->changed, NULL);
+
+	if (pthread_create(&out->thread, NULL, video_thread, out) != 0) {
+		pthread_cond_destroy(&out->changed);
+		pthread_mutex_destroy(&out->lock);
+		free(out);
+		return NULL;
+	}
+
+	return out;
+}
+
+/*
+* The frame_sink: copy the frame into the free buffer and hand it over.
+* Frames with nothing to write are not copied at all.
+*/
+void video_frame(void* ctx, const uint32_t* pixels, int64_t frame)
+{
+	video_out* out = (video_out*) ctx;
+	int next = out->next;
+
+	if (!out->stream && (!out->png_dir || frame % out->png_every != 0)) {
+		return;
+	}
+
+	pthread_mutex_lock(&out->lock);
+	while (out->full[next]) {
+		pthread_cond_wait(&out->changed, &out->lock);
+	}
+	pthread_mutex_unlock(&out->lock);
+
+	// the writer leaves an empty buffer alone, so the copy needs no lock
+	memcpy(out->pixels[next], pixels, sizeof(out->pixels[next]));
+	out->number[next] = frame;
+
+	pthread_mutex_lock(&out->lock);
+	out->full[next] = 1;
+	pthread_cond_broadcast(&out->changed);
+	pthread_mutex_unlock(&out->lock);
+	out->next = next ^ 1;
+}
+
+/* Write what is left and stop. Returns 0, or -1 if any write failed. */
+int video_close(video_out* out)
+{
+	int error;
+
+	if (!out) {
+		return 0;
+	}
+
+	pthread_mutex_lock(&out->lock);
+	out->stop = 1;
+	pthread_cond_broadcast(&out->changed);
+	pthread_mutex_unlock(&out->lock);
+	pthread_join(out->thread, NULL);
+
+	if (out->stream && fflush(out->stream) != 0) {
+		out->error = 1;
+	}
+
+	error = out->error;
+	pthread_cond_destroy(&out->changed);
+	pthread_mutex_destroy(&out->lock);
+	free(out);
+	return error ? -1 : 0;
+}
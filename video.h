@@ -0,0 +1,42 @@
+#ifndef VIDEO_H
+#define VIDEO_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <pthread.h>
+#include "graphics.h"
+
+#define VIDEO_RGBA 0 // 256x240x4 bytes per frame
+#define VIDEO_YUV 1 // planar yuv 4:2:0 (i420), bt.601 studio range
+
+/*
+* Writes the frames a renderer finishes: a raw stream for an encoder, and
+* every png_every frames a png into png_dir. Frames are converted and
+* written on a thread of its own from two buffers, so the drawing thread
+* only copies a frame and moves on, unless the writer is still busy with
+* both.
+*/
+typedef struct video_out {
+	FILE* stream; // NULL for no stream
+	int format; // VIDEO_RGBA or VIDEO_YUV
+	const char* png_dir; // NULL for no snapshots
+	int png_every;
+
+	pthread_t thread;
+	pthread_mutex_t lock;
+	pthread_cond_t changed;
+	char full[2]; // buffer holds a frame the writer has not taken
+	char stop;
+	int next; // buffer the next frame goes into
+	int error; // a write failed, later frames are dropped
+	int64_t number[2];
+	uint32_t pixels[2][PPU_WIDTH * PPU_HEIGHT];
+	uint8_t planes[PPU_WIDTH * PPU_HEIGHT * 3 / 2]; // the writer's yuv conversion
+} video_out;
+
+video_out* video_open(FILE* stream, int format, const char* png_dir, int png_every);
+void video_frame(void* ctx, const uint32_t* pixels, int64_t frame);
+int video_close(video_out* out);
+int png_write(FILE* fp, const uint32_t* pixels, int width, int height);
+
+#endif
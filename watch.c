@@ -0,0 +1,233 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "machine.h"
+#include "watch.h"
+
+/*
+* Watchpoints and the heatmap never touch the fast path. Turning either on
+* clears the page table entries of the pages involved, so only accesses to
+* those pages reach read_mem_slow and friends, which call watch_access.
+*/
+
+static watch_state* get_watch(machine* mch)
+{
+	if (!mch->watch) {
+		mch->watch = (watch_state*) calloc(1, sizeof(watch_state));
+	}
+	return mch->watch;
+}
+
+/* Drop the watch state once nothing is left in it, giving back the fast path */
+static void put_watch(machine* mch)
+{
+	watch_state* w = mch->watch;
+
+	if (w && w->num_points == 0 && !w->heatmap) {
+		free(w);
+		mch->watch = NULL;
+	}
+
+	map_pages(mch);
+}
+
+/* Default hit handler, just report the access */
+static void print_hit(machine* mch, uint16_t address, uint8_t value, uint8_t kind, void* user)
+{
+	const char* what = kind == WATCH_READ ? "read" : (kind == WATCH_WRITE ? "write" : "exec");
+	fprintf(stderr, "watch: %s %02x at %04x, pc %04x, cycle %lld\n", what, value, address, mch->cpu.pc, (long long) mch->cpu.cycle);
+}
+
+/* Watch start-end inclusive. Returns 0 on success, -1 if out of memory or slots. */
+int watch_add(machine* mch, uint16_t start, uint16_t end, uint8_t kind)
+{
+	watch_state* w = get_watch(mch);
+	int page;
+
+	if (!w || w->num_points == MAX_WATCHPOINTS || end < start) {
+		return -1;
+	}
+
+	w->points[w->num_points].start = start;
+	w->points[w->num_points].end = end;
+	w->points[w->num_points].kind = kind;
+	w->num_points++;
+
+	for (page = start >> 8; page <= end >> 8; page++) {
+		w->page_kind[page] |= kind;
+	}
+
+	map_pages(mch);
+	return 0;
+}
+
+void watch_clear(machine* mch)
+{
+	if (mch->watch) {
+		mch->watch->num_points = 0;
+		memset(mch->watch->page_kind, 0, sizeof(mch->watch->page_kind));
+		put_watch(mch);
+	}
+}
+
+void watch_set_callback(machine* mch, watch_fn hit, void* user)
+{
+	watch_state* w = get_watch(mch);
+
+	if (w) {
+		w->hit = hit;
+		w->user = user;
+	}
+}
+
+/* Start counting every access. Returns 0 on success. */
+int heatmap_enable(machine* mch)
+{
+	watch_state* w = get_watch(mch);
+
+	if (!w) {
+		return -1;
+	}
+
+	if (!w->heatmap) {
+		w->heatmap = (uint32_t*) calloc(0x10000, sizeof(uint32_t));
+		if (!w->heatmap) {
+			put_watch(mch);
+			return -1;
+		}
+	}
+
+	map_pages(mch);
+	return 0;
+}
+
+void heatmap_disable(machine* mch)
+{
+	if (mch->watch) {
+		free(mch->watch->heatmap);
+		mch->watch->heatmap = NULL;
+		put_watch(mch);
+	}
+}
+
+/* log2 of x in 8.8 fixed point, good enough to spread counts over 256 grays */
+static uint32_t log2_fixed(uint32_t x)
+{
+	uint32_t msb = 0;
+
+	while ((x >> msb) > 1) {
+		msb++;
+	}
+
+	// linear between powers of two
+	return (msb << 8) | (((uint64_t) x << 8 >> msb) & 0xFF);
+}
+
+/*
+* Write the heatmap as a 256x256 binary PGM, one row per page and one
+* column per byte, so the pixel at (x, y) is address y*256 + x. Counts are
+* log scaled so a few hot loops don't wash out the rest of the map.
+*/
+int heatmap_write_pgm(machine* mch, FILE* fp)
+{
+	uint32_t* heatmap = mch->watch ? mch->watch->heatmap : NULL;
+	uint8_t row[256];
+	uint32_t top = 0, scale;
+	int x, y;
+
+	if (!heatmap) {
+		return -1;
+	}
+
+	for (x = 0; x < 0x10000; x++) {
+		if (heatmap[x] > top) {
+			top = heatmap[x];
+		}
+	}
+	scale = log2_fixed(top + 1);
+	if (scale == 0) {
+		scale = 1;
+	}
+
+	fprintf(fp, "P5\n256 256\n255\n");
+
+	for (y = 0; y < 256; y++) {
+		for (x = 0; x < 256; x++) {
+			uint32_t count = heatmap[(y << 8) | x];
+			row[x] = count ? (uint8_t) (log2_fixed(count + 1) * 255 / scale) : 0;
+		}
+		if (fwrite(row, 1, sizeof(row), fp) != sizeof(row)) {
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+void watch_free(machine* mch)
+{
+	if (mch->watch) {
+		free(mch->watch->heatmap);
+		free(mch->watch);
+		mch->watch = NULL;
+	}
+}
+
+/* Punch holes in the page table for everything watched */
+void watch_unmap_pages(machine* mch)
+{
+	watch_state* w = mch->watch;
+	int page;
+
+	for (page = 0; page < NUM_PAGES; page++) {
+		uint8_t kind = w->page_kind[page];
+
+		// the heatmap has to see every access
+		if (w->heatmap) {
+			kind = WATCH_READ | WATCH_WRITE | WATCH_EXEC;
+		}
+
+		if (kind & WATCH_READ) {
+			mch->read_page[page] = NULL;
+		}
+		if (kind & WATCH_WRITE) {
+			mch->write_page[page] = NULL;
+		}
+		if (kind & WATCH_EXEC) {
+			mch->fetch_page[page] = NULL;
+		}
+		// predecoded instructions skip both the fetch and the operand reads
+		if (kind & (WATCH_READ | WATCH_EXEC)) {
+			mch->decode_page[page] = NULL;
+		}
+	}
+}
+
+/* Count the access and report it if a watchpoint covers it */
+void watch_access(machine* mch, uint16_t address, uint8_t value, uint8_t kind)
+{
+	watch_state* w = mch->watch;
+	int i;
+
+	if (w->heatmap) {
+		w->heatmap[address]++;
+	}
+
+	if (!(w->page_kind[address >> 8] & kind)) {
+		return;
+	}
+
+	for (i = 0; i < w->num_points; i++) {
+		watchpoint* p = &w->points[i];
+		if ((p->kind & kind) && address >= p->start && address <= p->end) {
+			w->hits++;
+			if (w->hit) {
+				w->hit(mch, address, value, kind, w->user);
+			} else {
+				print_hit(mch, address, value, kind, NULL);
+			}
+			return;
+		}
+	}
+}
@@ -0,0 +1,44 @@
+#ifndef WATCH_H
+#define WATCH_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include "machine.h"
+
+#define WATCH_READ 1
+#define WATCH_WRITE 2
+#define WATCH_EXEC 4
+#define MAX_WATCHPOINTS 32
+
+// called on every access that hits a watchpoint
+typedef void (*watch_fn)(machine* mch, uint16_t address, uint8_t value, uint8_t kind, void* user);
+
+typedef struct watchpoint {
+	uint16_t start; // first address watched
+	uint16_t end; // last address watched, inclusive
+	uint8_t kind; // any of WATCH_READ, WATCH_WRITE, WATCH_EXEC
+} watchpoint;
+
+typedef struct watch_state {
+	watchpoint points[MAX_WATCHPOINTS];
+	int num_points;
+	uint8_t page_kind[NUM_PAGES]; // kinds watched anywhere on each page
+	uint32_t* heatmap; // one counter per address, NULL when off
+	watch_fn hit;
+	void* user;
+	uint32_t hits;
+} watch_state;
+
+int watch_add(machine* mch, uint16_t start, uint16_t end, uint8_t kind);
+void watch_clear(machine* mch);
+void watch_set_callback(machine* mch, watch_fn hit, void* user);
+int heatmap_enable(machine* mch);
+void heatmap_disable(machine* mch);
+int heatmap_write_pgm(machine* mch, FILE* fp);
+void watch_free(machine* mch);
+
+// used by the memory slow path
+void watch_unmap_pages(machine* mch);
+void watch_access(machine* mch, uint16_t address, uint8_t value, uint8_t kind);
+
+#endif